@@ -0,0 +1,145 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Dijkstra's search towards a single target that orders vertices by the weight reached
+// so far plus a lower bound on the rest of the route, so it settles mostly the vertices
+// lying in the direction of the target. With a zero bound it is DijkstraRouter.
+template <typename Weight>
+class AStarRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    // Lower bound on the weight of any route from the first vertex to the second. A bound
+    // that drops along an edge by more than the edge's weight still gives the shortest
+    // routes, but vertices may then be settled more than once.
+    using LowerBound = std::function<Weight(VertexId from, VertexId to)>;
+
+    AStarRouter(const Graph& graph, LowerBound lower_bound);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    proto::RouterData OutProto() const override {
+        return {};
+    }
+
+    size_t GetSettledVertexCount() const override {
+        return settled_vertex_count_;
+    }
+
+private:
+    struct HeapItem {
+        Weight estimate;
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const HeapItem& other) const {
+            return estimate > other.estimate;
+        }
+    };
+
+    void StartSearch(VertexId from, VertexId to) const {
+        NextSearchId(search_id_, search_ids_);
+        heap_.clear();
+        Reach(from, to, ZERO_WEIGHT, std::nullopt);
+    }
+
+    bool IsReached(VertexId vertex) const {
+        return search_ids_[vertex] == search_id_;
+    }
+
+    void Reach(VertexId vertex, VertexId to, Weight weight, std::optional<EdgeId> prev_edge) const {
+        if (!IsReached(vertex)) {
+            search_ids_[vertex] = search_id_;
+            lower_bounds_[vertex] = lower_bound_(vertex, to);
+        }
+        weights_[vertex] = weight;
+        prev_edges_[vertex] = prev_edge;
+        heap_.push_back({weight + lower_bounds_[vertex], weight, vertex});
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>{});
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    LowerBound lower_bound_;
+
+    mutable uint32_t search_id_ = 0;
+    mutable std::vector<uint32_t> search_ids_;
+    mutable std::vector<Weight> weights_;
+    mutable std::vector<Weight> lower_bounds_;
+    mutable std::vector<std::optional<EdgeId>> prev_edges_;
+    mutable std::vector<HeapItem> heap_;
+    mutable size_t settled_vertex_count_ = 0;
+};
+
+template <typename Weight>
+AStarRouter<Weight>::AStarRouter(const Graph& graph, LowerBound lower_bound)
+    : graph_(graph)
+    , lower_bound_(std::move(lower_bound))
+    , search_ids_(graph.GetVertexCount())
+    , weights_(graph.GetVertexCount())
+    , lower_bounds_(graph.GetVertexCount())
+    , prev_edges_(graph.GetVertexCount())
+{
+    CheckEdgeWeightsNonNegative(graph);
+}
+
+template <typename Weight>
+std::optional<typename AStarRouter<Weight>::RouteInfo> AStarRouter<Weight>::BuildRoute(
+    VertexId from, VertexId to) const
+{
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+
+    StartSearch(from, to);
+    while (!heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>{});
+        const HeapItem item = heap_.back();
+        heap_.pop_back();
+        if (weights_[item.vertex] < item.weight) {
+            continue;
+        }
+        ++settled_vertex_count_;
+        if (item.vertex == to) {
+            break;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate_weight = item.weight + edge.weight;
+            if (!IsReached(edge.to) || candidate_weight < weights_[edge.to]) {
+                Reach(edge.to, to, candidate_weight, edge_id);
+            }
+        }
+    }
+
+    if (!IsReached(to)) {
+        return std::nullopt;
+    }
+    std::vector<EdgeId> edges;
+    for (std::optional<EdgeId> edge_id = prev_edges_[to];
+         edge_id;
+         edge_id = prev_edges_[graph_.GetEdge(*edge_id).from])
+    {
+        edges.push_back(*edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{weights_[to], std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "dijkstra_router.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Floyd-Warshall over a copy of the graph with narrower weights, so that twice as many
+// cells fit into a vector register and into cache. Integral weights are fixed-point:
+// an edge of weight w becomes round(w * scale). The routes it finds are reported
+// with weights summed over the original edges.
+template <typename Weight, typename CompactWeight>
+class CompactRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using CompactGraph = DirectedWeightedGraph<CompactWeight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    CompactRouter(const Graph& graph, double scale);
+    CompactRouter(const Graph& graph, double scale, const proto::Router& proto_router);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    std::optional<Weight> BuildRouteInto(VertexId from, VertexId to, std::vector<EdgeId>& edges) const override;
+
+    // Brings the compact copy of the graph up to date and repairs the table over it.
+    bool UpdateEdges(const std::vector<EdgeId>& edges) override;
+
+    proto::RouterData OutProto() const override;
+
+private:
+    static CompactWeight ToCompactWeight(Weight weight, double scale);
+    static CompactGraph CreateCompactGraph(const Graph& graph, double scale);
+
+    const Graph& graph_;
+    double scale_;
+    CompactGraph compact_graph_;
+    Router<CompactWeight> router_;
+};
+
+template <typename Weight, typename CompactWeight>
+CompactRouter<Weight, CompactWeight>::CompactRouter(const Graph& graph, double scale)
+    : graph_(graph)
+    , scale_(scale)
+    , compact_graph_(CreateCompactGraph(graph, scale))
+    , router_(compact_graph_) {
+}
+
+template <typename Weight, typename CompactWeight>
+CompactRouter<Weight, CompactWeight>::CompactRouter(const Graph& graph, double scale,
+                                                    const proto::Router& proto_router)
+    : graph_(graph)
+    , scale_(scale)
+    , compact_graph_(CreateCompactGraph(graph, scale))
+    , router_(compact_graph_, proto_router) {
+}
+
+template <typename Weight, typename CompactWeight>
+std::optional<typename CompactRouter<Weight, CompactWeight>::RouteInfo>
+CompactRouter<Weight, CompactWeight>::BuildRoute(VertexId from, VertexId to) const {
+    auto compact_route = router_.BuildRoute(from, to);
+    if (!compact_route) {
+        return std::nullopt;
+    }
+    Weight weight{};
+    for (const EdgeId edge_id : compact_route->edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+    }
+    return RouteInfo{weight, std::move(compact_route->edges)};
+}
+
+template <typename Weight, typename CompactWeight>
+std::optional<Weight> CompactRouter<Weight, CompactWeight>::BuildRouteInto(VertexId from, VertexId to,
+                                                                          std::vector<EdgeId>& edges) const {
+    if (!router_.BuildRouteInto(from, to, edges)) {
+        return std::nullopt;
+    }
+    Weight weight{};
+    for (const EdgeId edge_id : edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+    }
+    return weight;
+}
+
+template <typename Weight, typename CompactWeight>
+bool CompactRouter<Weight, CompactWeight>::UpdateEdges(const std::vector<EdgeId>& edges) {
+    while (compact_graph_.GetVertexCount() < graph_.GetVertexCount()) {
+        compact_graph_.AddVertex();
+    }
+    for (EdgeId edge_id = compact_graph_.GetEdgeCount(); edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        compact_graph_.AddEdge({edge.from, edge.to, ToCompactWeight(edge.weight, scale_)});
+    }
+    for (const EdgeId edge_id : edges) {
+        compact_graph_.SetEdgeWeight(edge_id, ToCompactWeight(graph_.GetEdge(edge_id).weight, scale_));
+    }
+    compact_graph_.Finalize();
+    return router_.UpdateEdges(edges);
+}
+
+template <typename Weight, typename CompactWeight>
+proto::RouterData CompactRouter<Weight, CompactWeight>::OutProto() const {
+    return router_.OutProto();
+}
+
+template <typename Weight, typename CompactWeight>
+CompactWeight CompactRouter<Weight, CompactWeight>::ToCompactWeight(Weight weight, double scale) {
+    // Routes must stay below the half-range infinity of the compact router.
+    constexpr double max_compact_weight = static_cast<double>(std::numeric_limits<CompactWeight>::max()) / 4;
+
+    const double compact_weight = std::is_integral_v<CompactWeight>
+                                  ? std::round(weight * scale)
+                                  : weight * scale;
+    if (compact_weight > max_compact_weight) {
+        throw std::domain_error("Edge weight doesn't fit into the compact weight");
+    }
+    return static_cast<CompactWeight>(compact_weight);
+}
+
+template <typename Weight, typename CompactWeight>
+typename CompactRouter<Weight, CompactWeight>::CompactGraph
+CompactRouter<Weight, CompactWeight>::CreateCompactGraph(const Graph& graph, double scale) {
+    CompactGraph compact_graph(graph.GetVertexCount());
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        compact_graph.AddEdge({edge.from, edge.to, ToCompactWeight(edge.weight, scale)});
+    }
+    compact_graph.Finalize();
+    return compact_graph;
+}
+
+struct RouterAccuracy {
+    size_t compared_count = 0;
+    size_t differing_count = 0;
+    double max_error = 0;
+    double mean_error = 0;
+};
+
+// Compares the weights of routes found by router with exact shortest routes on up to
+// sample_count pairs of vertices spread evenly over the graph.
+template <typename Weight>
+RouterAccuracy MeasureRouterAccuracy(const DirectedWeightedGraph<Weight>& graph, const RouterBase<Weight>& router,
+                                     size_t sample_count) {
+    RouterAccuracy accuracy;
+    const size_t vertex_count = graph.GetVertexCount();
+    const size_t pair_count = vertex_count * vertex_count;
+    if (pair_count == 0 || sample_count == 0) {
+        return accuracy;
+    }
+
+    const DijkstraRouter<Weight> reference(graph);
+    const size_t step = std::max<size_t>(1, pair_count / sample_count);
+    double error_sum = 0;
+    for (size_t pair = step / 2; pair < pair_count; pair += step) {
+        const auto exact_route = reference.BuildRoute(pair / vertex_count, pair % vertex_count);
+        const auto route = router.BuildRoute(pair / vertex_count, pair % vertex_count);
+        if (!exact_route || !route) {
+            accuracy.differing_count += static_cast<bool>(exact_route) != static_cast<bool>(route);
+            continue;
+        }
+        const double error = std::abs(static_cast<double>(route->weight - exact_route->weight));
+        ++accuracy.compared_count;
+        // Equal routes may still differ in the last bits when the additions go in another order.
+        accuracy.differing_count += error > 1e-9 * std::max(1.0, static_cast<double>(exact_route->weight));
+        accuracy.max_error = std::max(accuracy.max_error, error);
+        error_sum += error;
+    }
+    if (accuracy.compared_count > 0) {
+        accuracy.mean_error = error_sum / accuracy.compared_count;
+    }
+    return accuracy;
+}
+
+}  // namespace graph
@@ -0,0 +1,533 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include <router.pb.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Contracts vertices one by one, from the least important, and adds shortcut edges
+// that keep the distances between the remaining vertices. A query is then a pair of
+// searches that only go up the hierarchy: forward from the start and backward from
+// the finish. Shortcuts are unpacked back into the edges of the original graph.
+template <typename Weight>
+class ContractionHierarchy final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    explicit ContractionHierarchy(const Graph& graph);
+    ContractionHierarchy(const Graph& graph, const proto::ContractionHierarchy& proto_contraction_hierarchy);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    // Position of the vertex in the contraction order, higher is more important.
+    size_t GetRank(VertexId vertex) const;
+
+    size_t GetSettledVertexCount() const override;
+
+    proto::RouterData OutProto() const override;
+    void InProto(const proto::ContractionHierarchy& proto_contraction_hierarchy);
+
+private:
+    // Hierarchy edges are the edges of the graph followed by the shortcuts, so that
+    // ids below the graph's edge count are the graph's own edge ids.
+    struct Shortcut {
+        Edge<Weight> edge;
+        EdgeId first;
+        EdgeId second;
+    };
+
+    // A search that reuses its buffers between queries, see DijkstraRouter.
+    class SearchSpace {
+    public:
+        void Reset(size_t vertex_count);
+        void Start(VertexId from);
+
+        bool IsReached(VertexId vertex) const;
+        Weight GetWeight(VertexId vertex) const;
+        EdgeId GetPrevEdge(VertexId vertex) const;
+
+        void Reach(VertexId vertex, Weight weight, EdgeId prev_edge);
+
+        bool IsEmpty() const;
+        Weight GetMinWeight() const;
+        // Returns the closest vertex that is still up to date in the heap.
+        std::optional<VertexId> Pop();
+
+    private:
+        struct HeapItem {
+            Weight weight;
+            VertexId vertex;
+
+            bool operator>(const HeapItem& other) const {
+                return weight > other.weight;
+            }
+        };
+
+        uint32_t search_id_ = 0;
+        std::vector<uint32_t> search_ids_;
+        std::vector<Weight> weights_;
+        std::vector<EdgeId> prev_edges_;
+        std::vector<HeapItem> heap_;
+    };
+
+    Edge<Weight> GetHierarchyEdge(EdgeId edge_id) const;
+
+    void Contract();
+    void BuildUpwardEdges();
+    void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr EdgeId NONE_EDGE = std::numeric_limits<EdgeId>::max();
+    // Witness searches give up after settling this many vertices and keep the shortcut.
+    static constexpr size_t WITNESS_SETTLED_LIMIT = 100;
+
+    const Graph& graph_;
+    std::vector<size_t> ranks_;
+    std::vector<Shortcut> shortcuts_;
+
+    // Hierarchy edges going up from each vertex, and going down into it (which the
+    // backward search walks up in reverse), in compressed rows.
+    std::vector<size_t> forward_offsets_;
+    std::vector<EdgeId> forward_edges_;
+    std::vector<size_t> backward_offsets_;
+    std::vector<EdgeId> backward_edges_;
+
+    mutable SearchSpace forward_search_;
+    mutable SearchSpace backward_search_;
+    mutable size_t settled_vertex_count_ = 0;
+};
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::SearchSpace::Reset(size_t vertex_count) {
+    search_id_ = 0;
+    search_ids_.assign(vertex_count, 0);
+    weights_.assign(vertex_count, ZERO_WEIGHT);
+    prev_edges_.assign(vertex_count, NONE_EDGE);
+    heap_.clear();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::SearchSpace::Start(VertexId from) {
+    NextSearchId(search_id_, search_ids_);
+    heap_.clear();
+    Reach(from, ZERO_WEIGHT, NONE_EDGE);
+}
+
+template <typename Weight>
+bool ContractionHierarchy<Weight>::SearchSpace::IsReached(VertexId vertex) const {
+    return search_ids_[vertex] == search_id_;
+}
+
+template <typename Weight>
+Weight ContractionHierarchy<Weight>::SearchSpace::GetWeight(VertexId vertex) const {
+    return weights_[vertex];
+}
+
+template <typename Weight>
+EdgeId ContractionHierarchy<Weight>::SearchSpace::GetPrevEdge(VertexId vertex) const {
+    return prev_edges_[vertex];
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::SearchSpace::Reach(VertexId vertex, Weight weight, EdgeId prev_edge) {
+    search_ids_[vertex] = search_id_;
+    weights_[vertex] = weight;
+    prev_edges_[vertex] = prev_edge;
+    heap_.push_back({weight, vertex});
+    std::push_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>{});
+}
+
+template <typename Weight>
+bool ContractionHierarchy<Weight>::SearchSpace::IsEmpty() const {
+    return heap_.empty();
+}
+
+template <typename Weight>
+Weight ContractionHierarchy<Weight>::SearchSpace::GetMinWeight() const {
+    return heap_.front().weight;
+}
+
+template <typename Weight>
+std::optional<VertexId> ContractionHierarchy<Weight>::SearchSpace::Pop() {
+    while (!heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>{});
+        const HeapItem item = heap_.back();
+        heap_.pop_back();
+        if (!(weights_[item.vertex] < item.weight)) {
+            return item.vertex;
+        }
+    }
+    return std::nullopt;
+}
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph)
+    : graph_(graph)
+{
+    CheckEdgeWeightsNonNegative(graph);
+    Contract();
+    BuildUpwardEdges();
+}
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(
+    const Graph& graph, const proto::ContractionHierarchy& proto_contraction_hierarchy)
+    : graph_(graph)
+{
+    InProto(proto_contraction_hierarchy);
+}
+
+template <typename Weight>
+Edge<Weight> ContractionHierarchy<Weight>::GetHierarchyEdge(EdgeId edge_id) const {
+    const size_t edge_count = graph_.GetEdgeCount();
+    if (edge_id < edge_count) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        return {edge.from, edge.to, edge.weight};
+    }
+    return shortcuts_[edge_id - edge_count].edge;
+}
+
+template <typename Weight>
+size_t ContractionHierarchy<Weight>::GetRank(VertexId vertex) const {
+    return ranks_.at(vertex);
+}
+
+template <typename Weight>
+size_t ContractionHierarchy<Weight>::GetSettledVertexCount() const {
+    return settled_vertex_count_;
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Contract() {
+    struct WorkEdge {
+        VertexId vertex;
+        Weight weight;
+        EdgeId edge_id;
+    };
+    using WorkEdges = std::vector<WorkEdge>;
+
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<WorkEdges> out_edges(vertex_count);
+    std::vector<WorkEdges> in_edges(vertex_count);
+    std::vector<bool> contracted(vertex_count, false);
+    std::vector<size_t> contracted_neighbours(vertex_count, 0);
+
+    // Keeps only the lightest of parallel edges.
+    const auto add_work_edge = [&out_edges, &in_edges](VertexId from, VertexId to, Weight weight, EdgeId edge_id) {
+        auto out = std::find_if(out_edges[from].begin(), out_edges[from].end(),
+                                [to](const WorkEdge& work_edge) { return work_edge.vertex == to; });
+        if (out == out_edges[from].end()) {
+            out_edges[from].push_back({to, weight, edge_id});
+            in_edges[to].push_back({from, weight, edge_id});
+        } else if (weight < out->weight) {
+            *out = {to, weight, edge_id};
+            *std::find_if(in_edges[to].begin(), in_edges[to].end(),
+                          [from](const WorkEdge& work_edge) { return work_edge.vertex == from; }) = {from, weight, edge_id};
+        }
+    };
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.from != edge.to) {
+            add_work_edge(edge.from, edge.to, edge.weight, edge_id);
+        }
+    }
+
+    SearchSpace witness_search;
+    witness_search.Reset(vertex_count);
+
+    // Counts the shortcuts that contracting the vertex needs, and adds them if asked to.
+    const auto contract_vertex = [&](VertexId vertex, bool add_shortcuts) {
+        size_t shortcut_count = 0;
+        if (out_edges[vertex].empty()) {
+            return shortcut_count;
+        }
+        Weight max_out_weight = ZERO_WEIGHT;
+        for (const WorkEdge& out : out_edges[vertex]) {
+            max_out_weight = std::max(max_out_weight, out.weight);
+        }
+        for (const WorkEdge in : in_edges[vertex]) {
+            const Weight max_weight = in.weight + max_out_weight;
+            witness_search.Start(in.vertex);
+            for (size_t settled = 0; settled < WITNESS_SETTLED_LIMIT; ++settled) {
+                const auto witness_vertex = witness_search.Pop();
+                if (!witness_vertex || max_weight < witness_search.GetWeight(*witness_vertex)) {
+                    break;
+                }
+                const Weight weight = witness_search.GetWeight(*witness_vertex);
+                for (const WorkEdge& out : out_edges[*witness_vertex]) {
+                    if (out.vertex == vertex) {
+                        continue;
+                    }
+                    const Weight candidate_weight = weight + out.weight;
+                    if (!witness_search.IsReached(out.vertex) || candidate_weight < witness_search.GetWeight(out.vertex)) {
+                        witness_search.Reach(out.vertex, candidate_weight, NONE_EDGE);
+                    }
+                }
+            }
+
+            for (const WorkEdge out : out_edges[vertex]) {
+                const Weight weight = in.weight + out.weight;
+                if (out.vertex == in.vertex
+                    || (witness_search.IsReached(out.vertex) && !(weight < witness_search.GetWeight(out.vertex)))) {
+                    continue;
+                }
+                ++shortcut_count;
+                if (add_shortcuts) {
+                    const EdgeId edge_id = graph_.GetEdgeCount() + shortcuts_.size();
+                    shortcuts_.push_back({{in.vertex, out.vertex, weight}, in.edge_id, out.edge_id});
+                    add_work_edge(in.vertex, out.vertex, weight, edge_id);
+                }
+            }
+        }
+        return shortcut_count;
+    };
+
+    const auto get_priority = [&](VertexId vertex) {
+        const size_t shortcut_count = contract_vertex(vertex, false);
+        return static_cast<int64_t>(shortcut_count)
+            - static_cast<int64_t>(in_edges[vertex].size() + out_edges[vertex].size())
+            + static_cast<int64_t>(contracted_neighbours[vertex]);
+    };
+
+    using QueueItem = std::pair<int64_t, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        queue.push({get_priority(vertex), vertex});
+    }
+
+    ranks_.assign(vertex_count, 0);
+    size_t rank = 0;
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (contracted[vertex]) {
+            continue;
+        }
+        // Priorities go stale as neighbours get contracted, so they are refreshed lazily.
+        const int64_t priority = get_priority(vertex);
+        if (!queue.empty() && queue.top().first < priority) {
+            queue.push({priority, vertex});
+            continue;
+        }
+
+        contract_vertex(vertex, true);
+        contracted[vertex] = true;
+        ranks_[vertex] = rank++;
+
+        const auto remove_vertex = [vertex](WorkEdges& work_edges) {
+            work_edges.erase(std::remove_if(work_edges.begin(), work_edges.end(),
+                                            [vertex](const WorkEdge& work_edge) { return work_edge.vertex == vertex; }),
+                             work_edges.end());
+        };
+        for (const WorkEdge& in : in_edges[vertex]) {
+            remove_vertex(out_edges[in.vertex]);
+            ++contracted_neighbours[in.vertex];
+        }
+        for (const WorkEdge& out : out_edges[vertex]) {
+            remove_vertex(in_edges[out.vertex]);
+            ++contracted_neighbours[out.vertex];
+        }
+        WorkEdges().swap(in_edges[vertex]);
+        WorkEdges().swap(out_edges[vertex]);
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::BuildUpwardEdges() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const size_t hierarchy_edge_count = graph_.GetEdgeCount() + shortcuts_.size();
+
+    forward_offsets_.assign(vertex_count + 1, 0);
+    backward_offsets_.assign(vertex_count + 1, 0);
+    for (EdgeId edge_id = 0; edge_id < hierarchy_edge_count; ++edge_id) {
+        const auto& edge = GetHierarchyEdge(edge_id);
+        if (edge.from == edge.to) {
+            continue;
+        }
+        if (ranks_[edge.from] < ranks_[edge.to]) {
+            ++forward_offsets_[edge.from + 1];
+        } else {
+            ++backward_offsets_[edge.to + 1];
+        }
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        forward_offsets_[vertex + 1] += forward_offsets_[vertex];
+        backward_offsets_[vertex + 1] += backward_offsets_[vertex];
+    }
+
+    forward_edges_.resize(forward_offsets_[vertex_count]);
+    backward_edges_.resize(backward_offsets_[vertex_count]);
+    std::vector<size_t> forward_positions(forward_offsets_.begin(), forward_offsets_.end() - 1);
+    std::vector<size_t> backward_positions(backward_offsets_.begin(), backward_offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < hierarchy_edge_count; ++edge_id) {
+        const auto& edge = GetHierarchyEdge(edge_id);
+        if (edge.from == edge.to) {
+            continue;
+        }
+        if (ranks_[edge.from] < ranks_[edge.to]) {
+            forward_edges_[forward_positions[edge.from]++] = edge_id;
+        } else {
+            backward_edges_[backward_positions[edge.to]++] = edge_id;
+        }
+    }
+
+    forward_search_.Reset(vertex_count);
+    backward_search_.Reset(vertex_count);
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const {
+    std::vector<EdgeId> stack{edge_id};
+    while (!stack.empty()) {
+        const EdgeId top = stack.back();
+        stack.pop_back();
+        if (top < graph_.GetEdgeCount()) {
+            edges.push_back(top);
+        } else {
+            const Shortcut& shortcut = shortcuts_[top - graph_.GetEdgeCount()];
+            stack.push_back(shortcut.second);
+            stack.push_back(shortcut.first);
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::RouteInfo> ContractionHierarchy<Weight>::BuildRoute(
+    VertexId from, VertexId to) const
+{
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+
+    forward_search_.Start(from);
+    backward_search_.Start(to);
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+
+    while (true) {
+        const bool forward_open = !forward_search_.IsEmpty()
+            && (!best_weight || forward_search_.GetMinWeight() < *best_weight);
+        const bool backward_open = !backward_search_.IsEmpty()
+            && (!best_weight || backward_search_.GetMinWeight() < *best_weight);
+        if (!forward_open && !backward_open) {
+            break;
+        }
+        const bool forward = forward_open
+            && (!backward_open || !(backward_search_.GetMinWeight() < forward_search_.GetMinWeight()));
+        SearchSpace& search = forward ? forward_search_ : backward_search_;
+        const SearchSpace& other_search = forward ? backward_search_ : forward_search_;
+
+        const auto vertex = search.Pop();
+        if (!vertex) {
+            continue;
+        }
+        ++settled_vertex_count_;
+        const Weight weight = search.GetWeight(*vertex);
+        if (other_search.IsReached(*vertex)) {
+            const Weight candidate_weight = weight + other_search.GetWeight(*vertex);
+            if (!best_weight || candidate_weight < *best_weight) {
+                best_weight = candidate_weight;
+                meeting_vertex = *vertex;
+            }
+        }
+
+        const auto& offsets = forward ? forward_offsets_ : backward_offsets_;
+        const auto& upward_edges = forward ? forward_edges_ : backward_edges_;
+        for (size_t i = offsets[*vertex]; i < offsets[*vertex + 1]; ++i) {
+            const auto& edge = GetHierarchyEdge(upward_edges[i]);
+            const VertexId next_vertex = forward ? edge.to : edge.from;
+            const Weight candidate_weight = weight + edge.weight;
+            if (!search.IsReached(next_vertex) || candidate_weight < search.GetWeight(next_vertex)) {
+                search.Reach(next_vertex, candidate_weight, upward_edges[i]);
+            }
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> hierarchy_edges;
+    for (EdgeId edge_id = forward_search_.GetPrevEdge(meeting_vertex);
+         edge_id != NONE_EDGE;
+         edge_id = forward_search_.GetPrevEdge(GetHierarchyEdge(edge_id).from))
+    {
+        hierarchy_edges.push_back(edge_id);
+    }
+    std::reverse(hierarchy_edges.begin(), hierarchy_edges.end());
+    for (EdgeId edge_id = backward_search_.GetPrevEdge(meeting_vertex);
+         edge_id != NONE_EDGE;
+         edge_id = backward_search_.GetPrevEdge(GetHierarchyEdge(edge_id).to))
+    {
+        hierarchy_edges.push_back(edge_id);
+    }
+
+    Weight weight = ZERO_WEIGHT;
+    std::vector<EdgeId> edges;
+    for (const EdgeId edge_id : hierarchy_edges) {
+        UnpackEdge(edge_id, edges);
+    }
+    for (const EdgeId edge_id : edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+    }
+
+    return RouteInfo{weight, std::move(edges)};
+}
+
+template <typename Weight>
+proto::RouterData ContractionHierarchy<Weight>::OutProto() const {
+    proto::RouterData proto_router_data;
+    proto::ContractionHierarchy& proto_contraction_hierarchy = *proto_router_data.mutable_contraction_hierarchy();
+
+    for (const size_t rank : ranks_) {
+        proto_contraction_hierarchy.add_rank(rank);
+    }
+    for (int i = 0; i < shortcuts_.size(); ++i) {
+        proto::Shortcut proto_shortcut;
+        proto_shortcut.set_from(shortcuts_[i].edge.from);
+        proto_shortcut.set_to(shortcuts_[i].edge.to);
+        proto_shortcut.set_weight(shortcuts_[i].edge.weight);
+        proto_shortcut.set_first(shortcuts_[i].first);
+        proto_shortcut.set_second(shortcuts_[i].second);
+
+        proto_contraction_hierarchy.add_shortcut();
+        *proto_contraction_hierarchy.mutable_shortcut(i) = std::move(proto_shortcut);
+    }
+
+    return proto_router_data;
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::InProto(const proto::ContractionHierarchy& proto_contraction_hierarchy) {
+    if (proto_contraction_hierarchy.rank_size() != graph_.GetVertexCount()) {
+        throw std::invalid_argument("Contraction hierarchy doesn't match the graph");
+    }
+
+    ranks_.assign(proto_contraction_hierarchy.rank().begin(), proto_contraction_hierarchy.rank().end());
+
+    shortcuts_.resize(proto_contraction_hierarchy.shortcut_size());
+    for (int i = 0; i < proto_contraction_hierarchy.shortcut_size(); ++i) {
+        const proto::Shortcut& proto_shortcut = proto_contraction_hierarchy.shortcut(i);
+
+        shortcuts_[i] = { {proto_shortcut.from(), proto_shortcut.to(), static_cast<Weight>(proto_shortcut.weight())},
+                          proto_shortcut.first(), proto_shortcut.second() };
+    }
+
+    BuildUpwardEdges();
+}
+
+}  // namespace graph
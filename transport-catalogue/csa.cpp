@@ -0,0 +1,305 @@
+#include "csa.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+using namespace std;
+
+namespace csa {
+
+namespace {
+
+constexpr size_t NONE_STOP = numeric_limits<size_t>::max();
+constexpr uint32_t NONE_CONNECTION = numeric_limits<uint32_t>::max();
+constexpr double INFINITE_TIME = numeric_limits<double>::infinity();
+
+} // namespace
+
+ConnectionScan::ConnectionScan(const transport::TransportCatalogue& transport_catalogue,
+                               const transport_router::RoutingSettings& routing_settings)
+: stop_count_(transport_catalogue.GetStopCount())
+, closures_(transport_catalogue.GetStopCount(), transport_catalogue.GetBusCount()) {
+    for (size_t bus_index = 0; bus_index < transport_catalogue.GetBusCount(); ++bus_index) {
+        AddTrips(bus_index, transport_catalogue.FindBus(bus_index), routing_settings.bus_velocity);
+    }
+    sort(connections_.begin(), connections_.end(), [](const Connection& lhs, const Connection& rhs) {
+        return tie(lhs.departure_time, lhs.trip_index, lhs.trip_position)
+             < tie(rhs.departure_time, rhs.trip_index, rhs.trip_position);
+    });
+}
+
+ConnectionScan::ConnectionScan(const transport::TransportCatalogue& transport_catalogue,
+                               const proto::Connections& proto_connections)
+: stop_count_(transport_catalogue.GetStopCount())
+, closures_(transport_catalogue.GetStopCount(), transport_catalogue.GetBusCount()) {
+    InProto(proto_connections);
+}
+
+void ConnectionScan::AddTrips(size_t bus_index, const domain::Bus& bus, double bus_velocity) {
+    vector<size_t> stop_indexs = bus.stop_indexs;
+    if (!bus.ring && !stop_indexs.empty()) {
+        stop_indexs.insert(stop_indexs.end(), next(bus.stop_indexs.rbegin()), bus.stop_indexs.rend());
+    }
+    vector<double> segment_times;
+    for (size_t i = 1; i < bus.forward_distances.size(); ++i) {
+        segment_times.push_back((bus.forward_distances[i] - bus.forward_distances[i - 1]) / (bus_velocity * 1000.0 / 60));
+    }
+    for (size_t i = 1; i < bus.backward_distances.size(); ++i) {
+        segment_times.push_back((bus.backward_distances[i] - bus.backward_distances[i - 1]) / (bus_velocity * 1000.0 / 60));
+    }
+
+    for (const double departure : bus.departures) {
+        const uint32_t trip_index = static_cast<uint32_t>(trip_bus_indexs_.size());
+        trip_bus_indexs_.push_back(static_cast<uint32_t>(bus_index));
+        double time = departure;
+        for (size_t i = 0; i < segment_times.size(); ++i) {
+            connections_.push_back({time, time + segment_times[i],
+                                    static_cast<uint32_t>(stop_indexs[i]), static_cast<uint32_t>(stop_indexs[i + 1]),
+                                    trip_index, static_cast<uint32_t>(i)});
+            time += segment_times[i];
+        }
+    }
+}
+
+size_t ConnectionScan::GetConnectionCount() const {
+    return connections_.size();
+}
+
+void ConnectionScan::Scan(size_t from_stop_index, double departure_time, size_t to_stop_index,
+                          double max_arrival_time) const {
+    arrival_times_.assign(stop_count_, INFINITE_TIME);
+    journeys_.resize(stop_count_);
+    trip_enter_connections_.assign(trip_bus_indexs_.size(), NONE_CONNECTION);
+    arrival_times_[from_stop_index] = departure_time;
+
+    const auto first = lower_bound(connections_.begin(), connections_.end(), departure_time,
+        [](const Connection& connection, double time) { return connection.departure_time < time; });
+    for (auto it = first; it != connections_.end(); ++it) {
+        const Connection& connection = *it;
+        if (connection.departure_time > max_arrival_time
+            || (to_stop_index != NONE_STOP && connection.departure_time >= arrival_times_[to_stop_index])) {
+            break;
+        }
+        if (closures_.IsBusClosed(trip_bus_indexs_[connection.trip_index])) {
+            continue;
+        }
+        uint32_t& enter_connection = trip_enter_connections_[connection.trip_index];
+        if (enter_connection == NONE_CONNECTION && arrival_times_[connection.from_stop_index] <= connection.departure_time
+            && !closures_.IsStopClosed(connection.from_stop_index)) {
+            enter_connection = static_cast<uint32_t>(it - connections_.begin());
+        }
+        if (enter_connection != NONE_CONNECTION && connection.arrival_time < arrival_times_[connection.to_stop_index]
+            && !closures_.IsStopClosed(connection.to_stop_index)) {
+            arrival_times_[connection.to_stop_index] = connection.arrival_time;
+            journeys_[connection.to_stop_index] = {enter_connection, static_cast<uint32_t>(it - connections_.begin())};
+        }
+    }
+}
+
+transport_router::Ride ConnectionScan::MakeRide(const Journey& journey, double board_stop_arrival_time) const {
+    const Connection& enter = connections_[journey.enter_connection];
+    const Connection& exit = connections_[journey.exit_connection];
+    const double wait_time = enter.departure_time - board_stop_arrival_time;
+    return {trip_bus_indexs_[enter.trip_index], enter.from_stop_index, exit.trip_position - enter.trip_position + 1,
+            wait_time + exit.arrival_time - enter.departure_time, wait_time};
+}
+
+optional<transport_router::Route> ConnectionScan::ExtractRoute(size_t from_stop_index, double departure_time,
+                                                               size_t to_stop_index) const {
+    if (arrival_times_[to_stop_index] == INFINITE_TIME) {
+        return nullopt;
+    }
+
+    transport_router::Route route{arrival_times_[to_stop_index] - departure_time, {}};
+    for (size_t stop_index = to_stop_index; stop_index != from_stop_index;) {
+        const Journey& journey = journeys_[stop_index];
+        stop_index = connections_[journey.enter_connection].from_stop_index;
+        route.rides.push_back(MakeRide(journey, arrival_times_[stop_index]));
+    }
+    reverse(route.rides.begin(), route.rides.end());
+    return route;
+}
+
+optional<transport_router::Route> ConnectionScan::BuildRoute(size_t from_stop_index, size_t to_stop_index) const {
+    return BuildRouteAt(from_stop_index, to_stop_index, 0);
+}
+
+optional<transport_router::Route> ConnectionScan::BuildRouteAt(size_t from_stop_index, size_t to_stop_index,
+                                                               double departure_time) const {
+    if (from_stop_index >= stop_count_ || to_stop_index >= stop_count_) {
+        throw out_of_range("Stop is out of range");
+    }
+    Scan(from_stop_index, departure_time, to_stop_index, INFINITE_TIME);
+    return ExtractRoute(from_stop_index, departure_time, to_stop_index);
+}
+
+vector<optional<transport_router::Route>> ConnectionScan::BuildRoutes(
+    size_t from_stop_index, const vector<size_t>& to_stop_indexs) const {
+    if (from_stop_index >= stop_count_
+        || any_of(to_stop_indexs.begin(), to_stop_indexs.end(), [this](size_t index) { return index >= stop_count_; }))
+    {
+        throw out_of_range("Stop is out of range");
+    }
+    Scan(from_stop_index, 0, NONE_STOP, INFINITE_TIME);
+
+    vector<optional<transport_router::Route>> routes;
+    routes.reserve(to_stop_indexs.size());
+    for (const size_t to_stop_index : to_stop_indexs) {
+        routes.push_back(ExtractRoute(from_stop_index, 0, to_stop_index));
+    }
+    return routes;
+}
+
+vector<transport_router::StopArrival> ConnectionScan::FindReachableStops(size_t from_stop_index,
+                                                                         double max_weight) const {
+    if (from_stop_index >= stop_count_) {
+        throw out_of_range("Stop is out of range");
+    }
+    vector<transport_router::StopArrival> result;
+    if (max_weight < 0) {
+        return result;
+    }
+    Scan(from_stop_index, 0, NONE_STOP, max_weight);
+    for (size_t stop_index = 0; stop_index < stop_count_; ++stop_index) {
+        if (arrival_times_[stop_index] <= max_weight) {
+            result.push_back({stop_index, arrival_times_[stop_index]});
+        }
+    }
+    return result;
+}
+
+vector<transport_router::Route> ConnectionScan::BuildParetoRoutes(size_t from_stop_index,
+                                                                  size_t to_stop_index) const {
+    if (from_stop_index >= stop_count_ || to_stop_index >= stop_count_) {
+        throw out_of_range("Stop is out of range");
+    }
+    if (from_stop_index == to_stop_index) {
+        return {transport_router::Route{0, {}}};
+    }
+
+    // arrival_times_ keeps the best over all the rounds so far: a round only labels the
+    // stops it reaches sooner than with fewer rides.
+    arrival_times_.assign(stop_count_, INFINITE_TIME);
+    arrival_times_[from_stop_index] = 0;
+    if (round_arrival_times_.empty()) {
+        round_arrival_times_.emplace_back();
+        round_journeys_.emplace_back();
+    }
+    round_arrival_times_[0].assign(stop_count_, INFINITE_TIME);
+    round_arrival_times_[0][from_stop_index] = 0;
+
+    size_t round = 0;
+    for (bool improved = true; improved;) {
+        improved = false;
+        ++round;
+        if (round_arrival_times_.size() <= round) {
+            round_arrival_times_.emplace_back();
+            round_journeys_.emplace_back();
+        }
+        const vector<double>& prev_arrival_times = round_arrival_times_[round - 1];
+        vector<double>& round_arrival_times = round_arrival_times_[round];
+        vector<Journey>& round_journeys = round_journeys_[round];
+        round_arrival_times.assign(stop_count_, INFINITE_TIME);
+        round_journeys.resize(stop_count_);
+        trip_enter_connections_.assign(trip_bus_indexs_.size(), NONE_CONNECTION);
+
+        for (size_t i = 0; i < connections_.size(); ++i) {
+            const Connection& connection = connections_[i];
+            if (connection.departure_time >= arrival_times_[to_stop_index]) {
+                break;
+            }
+            if (closures_.IsBusClosed(trip_bus_indexs_[connection.trip_index])) {
+                continue;
+            }
+            uint32_t& enter_connection = trip_enter_connections_[connection.trip_index];
+            if (enter_connection == NONE_CONNECTION
+                && prev_arrival_times[connection.from_stop_index] <= connection.departure_time
+                && !closures_.IsStopClosed(connection.from_stop_index)) {
+                enter_connection = static_cast<uint32_t>(i);
+            }
+            if (enter_connection != NONE_CONNECTION && connection.arrival_time < arrival_times_[connection.to_stop_index]
+                && !closures_.IsStopClosed(connection.to_stop_index)) {
+                arrival_times_[connection.to_stop_index] = connection.arrival_time;
+                round_arrival_times[connection.to_stop_index] = connection.arrival_time;
+                round_journeys[connection.to_stop_index] = {enter_connection, static_cast<uint32_t>(i)};
+                improved = true;
+            }
+        }
+    }
+
+    vector<transport_router::Route> routes;
+    for (size_t last_round = 1; last_round < round; ++last_round) {
+        if (round_arrival_times_[last_round][to_stop_index] == INFINITE_TIME) {
+            continue;
+        }
+        transport_router::Route route{round_arrival_times_[last_round][to_stop_index], {}};
+        size_t stop_index = to_stop_index;
+        for (size_t ride_round = last_round; ride_round > 0; --ride_round) {
+            const Journey& journey = round_journeys_[ride_round][stop_index];
+            stop_index = connections_[journey.enter_connection].from_stop_index;
+            route.rides.push_back(MakeRide(journey, round_arrival_times_[ride_round - 1][stop_index]));
+        }
+        reverse(route.rides.begin(), route.rides.end());
+        routes.push_back(move(route));
+    }
+    return routes;
+}
+
+void ConnectionScan::SetClosures(const transport_router::Closures& closures) {
+    closures_.Set(closures);
+}
+
+optional<transport_router::Route> ConnectionScan::BuildRouteAvoiding(
+    size_t from_stop_index, size_t to_stop_index, double departure_time,
+    const transport_router::Closures& avoid) const {
+    if (from_stop_index >= stop_count_ || to_stop_index >= stop_count_) {
+        throw out_of_range("Stop is out of range");
+    }
+    const transport_router::Closures added = closures_.Add(avoid);
+    auto route = BuildRouteAt(from_stop_index, to_stop_index, departure_time);
+    closures_.Reopen(added);
+    return route;
+}
+
+proto::RouterData ConnectionScan::OutProto() const {
+    proto::RouterData proto_router_data;
+    proto::Connections& proto_connections = *proto_router_data.mutable_connections();
+
+    for (const Connection& connection : connections_) {
+        proto_connections.add_departure_time(connection.departure_time);
+        proto_connections.add_arrival_time(connection.arrival_time);
+        proto_connections.add_from_stop(connection.from_stop_index);
+        proto_connections.add_to_stop(connection.to_stop_index);
+        proto_connections.add_trip(connection.trip_index);
+        proto_connections.add_trip_position(connection.trip_position);
+    }
+    for (const uint32_t bus_index : trip_bus_indexs_) {
+        proto_connections.add_trip_bus(bus_index);
+    }
+
+    return proto_router_data;
+}
+
+void ConnectionScan::InProto(const proto::Connections& proto_connections) {
+    const int connection_count = proto_connections.departure_time_size();
+    if (proto_connections.arrival_time_size() != connection_count
+        || proto_connections.from_stop_size() != connection_count
+        || proto_connections.to_stop_size() != connection_count
+        || proto_connections.trip_size() != connection_count
+        || proto_connections.trip_position_size() != connection_count)
+    {
+        throw invalid_argument("Connection columns differ in length");
+    }
+
+    connections_.resize(connection_count);
+    for (int i = 0; i < connection_count; ++i) {
+        connections_[i] = {proto_connections.departure_time(i), proto_connections.arrival_time(i),
+                           proto_connections.from_stop(i), proto_connections.to_stop(i),
+                           proto_connections.trip(i), proto_connections.trip_position(i)};
+    }
+    trip_bus_indexs_.assign(proto_connections.trip_bus().begin(), proto_connections.trip_bus().end());
+}
+
+} // namespace csa
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include <router.pb.h>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace csa {
+
+// Connection Scan over the buses' timetables: every trip of a bus is cut into connections
+// between consecutive stops, and a query scans them once in order of departure, boarding
+// whatever leaves a stop after the rider got there. Routes are exact timetable journeys:
+// the waits are the real ones instead of the bus wait time of the routing settings.
+//
+// Queries without a departure time leave at the start of the day. Buses without
+// departures aren't ridden.
+class ConnectionScan final : public transport_router::RouteBuilder {
+public:
+    ConnectionScan(const transport::TransportCatalogue& transport_catalogue,
+                   const transport_router::RoutingSettings& routing_settings);
+    ConnectionScan(const transport::TransportCatalogue& transport_catalogue,
+                   const proto::Connections& proto_connections);
+
+    std::optional<transport_router::Route> BuildRoute(size_t from_stop_index, size_t to_stop_index) const override;
+
+    std::optional<transport_router::Route> BuildRouteAt(size_t from_stop_index, size_t to_stop_index,
+                                                        double departure_time) const override;
+
+    // One scan without a target serves all the stops.
+    std::vector<std::optional<transport_router::Route>> BuildRoutes(
+        size_t from_stop_index, const std::vector<size_t>& to_stop_indexs) const override;
+
+    std::vector<transport_router::StopArrival> FindReachableStops(size_t from_stop_index,
+                                                                  double max_weight) const override;
+
+    // A scan per number of rides, boarding only at the stops the previous scan improved.
+    std::vector<transport_router::Route> BuildParetoRoutes(size_t from_stop_index,
+                                                           size_t to_stop_index) const override;
+
+    // Trips of closed buses are skipped, and closed stops are neither boarded at nor arrived at.
+    void SetClosures(const transport_router::Closures& closures) override;
+
+    std::optional<transport_router::Route> BuildRouteAvoiding(size_t from_stop_index, size_t to_stop_index,
+                                                              double departure_time,
+                                                              const transport_router::Closures& avoid) const override;
+
+    size_t GetConnectionCount() const;
+
+    proto::RouterData OutProto() const;
+    void InProto(const proto::Connections& proto_connections);
+
+private:
+    // A trip between two consecutive stops of its route.
+    struct Connection {
+        double departure_time;
+        double arrival_time;
+        uint32_t from_stop_index;
+        uint32_t to_stop_index;
+        uint32_t trip_index;
+        uint32_t trip_position;
+    };
+
+    // The last ride of the best route to a stop: boarded at the first connection, left
+    // after the second.
+    struct Journey {
+        uint32_t enter_connection;
+        uint32_t exit_connection;
+    };
+
+    void AddTrips(size_t bus_index, const domain::Bus& bus, double bus_velocity);
+
+    // Scans the connections leaving no earlier than departure_time until none can arrive
+    // at to_stop_index sooner, or leaves later than max_arrival_time. The largest size_t
+    // is no target.
+    void Scan(size_t from_stop_index, double departure_time, size_t to_stop_index, double max_arrival_time) const;
+
+    transport_router::Ride MakeRide(const Journey& journey, double board_stop_arrival_time) const;
+
+    std::optional<transport_router::Route> ExtractRoute(size_t from_stop_index, double departure_time,
+                                                        size_t to_stop_index) const;
+
+    size_t stop_count_ = 0;
+    // Sorted by departure time.
+    std::vector<Connection> connections_;
+    std::vector<uint32_t> trip_bus_indexs_;
+    // Avoided stops and buses join the closures for the time of a query.
+    mutable transport_router::ClosureFlags closures_;
+
+    mutable std::vector<double> arrival_times_;
+    mutable std::vector<Journey> journeys_;
+    mutable std::vector<uint32_t> trip_enter_connections_;
+    mutable std::vector<std::vector<double>> round_arrival_times_;
+    mutable std::vector<std::vector<Journey>> round_journeys_;
+};
+
+} // namespace csa
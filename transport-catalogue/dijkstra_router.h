@@ -0,0 +1,296 @@
+#pragma once
+
+#include "graph.h"
+#include "graph_mask.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Answers every query with its own single-source search instead of
+// precomputing all pairs.
+template <typename Weight>
+class DijkstraRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    explicit DijkstraRouter(const Graph& graph);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    std::optional<Weight> BuildRouteInto(VertexId from, VertexId to, std::vector<EdgeId>& edges) const override;
+
+    // One search that stops once every target is settled.
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& to) const override;
+
+    // The same searches around the mask: closures need no preprocessing to honour.
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, const GraphMask& mask) const;
+    std::optional<Weight> BuildRouteInto(VertexId from, VertexId to, const GraphMask& mask,
+                                         std::vector<EdgeId>& edges) const;
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& to,
+                                                      const GraphMask& mask) const;
+
+    proto::RouterData OutProto() const override {
+        return {};
+    }
+
+    size_t GetSettledVertexCount() const override {
+        return settled_vertex_count_;
+    }
+
+private:
+    struct HeapItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const HeapItem& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    void StartSearch(VertexId from) const {
+        NextSearchId(search_id_, search_ids_, target_search_ids_);
+        heap_.clear();
+        Reach(from, ZERO_WEIGHT, std::nullopt);
+    }
+
+    std::optional<RouteInfo> FindRoute(VertexId from, VertexId to, const GraphMask* mask) const;
+    std::optional<Weight> FindRouteInto(VertexId from, VertexId to, const GraphMask* mask,
+                                        std::vector<EdgeId>& edges) const;
+    std::vector<std::optional<RouteInfo>> FindRoutes(VertexId from, const std::vector<VertexId>& to,
+                                                     const GraphMask* mask) const;
+
+    // Settles vertices in order of weight until target_count of the vertices marked
+    // as targets of the current search are settled, keeping out of the mask if there is one.
+    void Search(size_t target_count, const GraphMask* mask) const;
+
+    std::optional<RouteInfo> ExtractRoute(VertexId to) const;
+    std::optional<Weight> ExtractRouteInto(VertexId to, std::vector<EdgeId>& edges) const;
+
+    bool IsReached(VertexId vertex) const {
+        return search_ids_[vertex] == search_id_;
+    }
+
+    void Reach(VertexId vertex, Weight weight, std::optional<EdgeId> prev_edge) const {
+        search_ids_[vertex] = search_id_;
+        weights_[vertex] = weight;
+        prev_edges_[vertex] = prev_edge;
+        heap_.push_back({weight, vertex});
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>{});
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+
+    mutable uint32_t search_id_ = 0;
+    mutable std::vector<uint32_t> search_ids_;
+    mutable std::vector<uint32_t> target_search_ids_;
+    mutable std::vector<Weight> weights_;
+    mutable std::vector<std::optional<EdgeId>> prev_edges_;
+    mutable std::vector<HeapItem> heap_;
+    mutable size_t settled_vertex_count_ = 0;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+    : graph_(graph)
+    , search_ids_(graph.GetVertexCount())
+    , target_search_ids_(graph.GetVertexCount())
+    , weights_(graph.GetVertexCount())
+    , prev_edges_(graph.GetVertexCount())
+{
+    CheckEdgeWeightsNonNegative(graph);
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(
+    VertexId from, VertexId to) const
+{
+    return FindRoute(from, to, nullptr);
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::BuildRouteInto(VertexId from, VertexId to,
+                                                             std::vector<EdgeId>& edges) const
+{
+    return FindRouteInto(from, to, nullptr, edges);
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(
+    VertexId from, VertexId to, const GraphMask& mask) const
+{
+    return FindRoute(from, to, &mask);
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::BuildRouteInto(VertexId from, VertexId to, const GraphMask& mask,
+                                                             std::vector<EdgeId>& edges) const
+{
+    return FindRouteInto(from, to, &mask, edges);
+}
+
+template <typename Weight>
+std::vector<std::optional<typename DijkstraRouter<Weight>::RouteInfo>> DijkstraRouter<Weight>::BuildRoutes(
+    VertexId from, const std::vector<VertexId>& to) const
+{
+    return FindRoutes(from, to, nullptr);
+}
+
+template <typename Weight>
+std::vector<std::optional<typename DijkstraRouter<Weight>::RouteInfo>> DijkstraRouter<Weight>::BuildRoutes(
+    VertexId from, const std::vector<VertexId>& to, const GraphMask& mask) const
+{
+    return FindRoutes(from, to, &mask);
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::FindRoute(
+    VertexId from, VertexId to, const GraphMask* mask) const
+{
+    std::vector<EdgeId> edges;
+    const auto weight = FindRouteInto(from, to, mask, edges);
+    if (!weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::FindRouteInto(
+    VertexId from, VertexId to, const GraphMask* mask, std::vector<EdgeId>& edges) const
+{
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+
+    StartSearch(from);
+    target_search_ids_[to] = search_id_;
+    Search(1, mask);
+    return ExtractRouteInto(to, edges);
+}
+
+template <typename Weight>
+std::vector<std::optional<typename DijkstraRouter<Weight>::RouteInfo>> DijkstraRouter<Weight>::FindRoutes(
+    VertexId from, const std::vector<VertexId>& to, const GraphMask* mask) const
+{
+    if (from >= graph_.GetVertexCount()
+        || std::any_of(to.begin(), to.end(), [this](VertexId vertex) { return vertex >= graph_.GetVertexCount(); }))
+    {
+        throw std::out_of_range("Vertex is out of range");
+    }
+
+    StartSearch(from);
+    size_t target_count = 0;
+    for (const VertexId vertex : to) {
+        if (target_search_ids_[vertex] != search_id_) {
+            target_search_ids_[vertex] = search_id_;
+            ++target_count;
+        }
+    }
+    Search(target_count, mask);
+
+    std::vector<std::optional<RouteInfo>> routes;
+    routes.reserve(to.size());
+    for (const VertexId vertex : to) {
+        routes.push_back(ExtractRoute(vertex));
+    }
+    return routes;
+}
+
+template <typename Weight>
+void DijkstraRouter<Weight>::Search(size_t target_count, const GraphMask* mask) const {
+    while (target_count > 0 && !heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<HeapItem>{});
+        const auto [weight, vertex] = heap_.back();
+        heap_.pop_back();
+        if (weights_[vertex] < weight) {
+            continue;
+        }
+        ++settled_vertex_count_;
+        if (target_search_ids_[vertex] == search_id_ && --target_count == 0) {
+            break;
+        }
+        if (mask && mask->IsMasked(vertex)) {
+            continue;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (mask && mask->IsMasked(edge_id, edge)) {
+                continue;
+            }
+            const Weight candidate_weight = weight + edge.weight;
+            if (!IsReached(edge.to) || candidate_weight < weights_[edge.to]) {
+                Reach(edge.to, candidate_weight, edge_id);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::ExtractRoute(VertexId to) const {
+    std::vector<EdgeId> edges;
+    const auto weight = ExtractRouteInto(to, edges);
+    if (!weight) {
+        return std::nullopt;
+    }
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::ExtractRouteInto(VertexId to, std::vector<EdgeId>& edges) const {
+    if (!IsReached(to)) {
+        return std::nullopt;
+    }
+    edges.clear();
+    for (std::optional<EdgeId> edge_id = prev_edges_[to];
+         edge_id;
+         edge_id = prev_edges_[graph_.GetEdge(*edge_id).from])
+    {
+        edges.push_back(*edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    return weights_[to];
+}
+
+struct SearchEffort {
+    size_t route_count = 0;
+    size_t settled_vertex_count = 0;
+    size_t dijkstra_settled_vertex_count = 0;
+};
+
+// Counts the vertices that router and plain Dijkstra's search settle while building routes
+// between up to sample_count pairs of vertices spread evenly over the graph.
+template <typename Weight>
+SearchEffort MeasureSearchEffort(const DirectedWeightedGraph<Weight>& graph, const RouterBase<Weight>& router,
+                                 size_t sample_count) {
+    SearchEffort effort;
+    const size_t vertex_count = graph.GetVertexCount();
+    const size_t pair_count = vertex_count * vertex_count;
+    if (pair_count == 0 || sample_count == 0) {
+        return effort;
+    }
+
+    const DijkstraRouter<Weight> reference(graph);
+    const size_t settled_before = router.GetSettledVertexCount();
+    const size_t step = std::max<size_t>(1, pair_count / sample_count);
+    for (size_t pair = step / 2; pair < pair_count; pair += step) {
+        reference.BuildRoute(pair / vertex_count, pair % vertex_count);
+        router.BuildRoute(pair / vertex_count, pair % vertex_count);
+        ++effort.route_count;
+    }
+    effort.settled_vertex_count = router.GetSettledVertexCount() - settled_before;
+    effort.dijkstra_settled_vertex_count = reference.GetSettledVertexCount();
+    return effort;
+}
+
+}  // namespace graph
@@ -1,18 +1,22 @@
 #pragma once
 
 #include "geo.h"
+#include "ranges.h"
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 namespace domain {
     
+// A stop as the catalogue keeps it, spread over its arrays. The view holds until the
+// catalogue changes.
 struct Stop {
-    std::string name;
+    std::string_view name;
     geo::Coordinates coordinates;
-    std::unordered_map<size_t, int> distance_to_stops = {};
 
-    std::vector<size_t> bus_indexs = {};
+    // The buses through the stop in the order of their names, none while the catalogue
+    // isn't finalized.
+    ranges::Range<std::vector<size_t>::const_iterator> bus_indexs;
 };
 
 struct Bus {
@@ -24,6 +28,16 @@ struct Bus {
     double ideal_length = 0;
     size_t count_stops = 0;
     size_t count_unique_stops = 0;
+
+    // Times the bus leaves its first stop, in minutes from the start of the day, ascending.
+    // A trip rides the whole route, there and back for a non-ring bus.
+    std::vector<double> departures = {};
+
+    // Road distance from the first stop to each stop of the route, and for a non-ring bus
+    // from the last stop to each stop on the way back, in the order the bus rides them.
+    // The distance between two stops of a ride is then one subtraction.
+    std::vector<int> forward_distances = {};
+    std::vector<int> backward_distances = {};
 };
     
 } // namespace domain
\ No newline at end of file
@@ -1,7 +1,9 @@
 #define _USE_MATH_DEFINES
 #include "geo.h"
 
+#include <algorithm>
 #include <cmath>
+#include <utility>
 
 namespace geo {
 
@@ -14,4 +16,34 @@ double ComputeDistance(Coordinates from, Coordinates to) {
         * radius_earth;
 }
 
+uint64_t ComputeHilbertIndex(Coordinates point, Coordinates min, Coordinates max) {
+    using namespace std;
+    constexpr uint32_t side = 1 << 16;
+    const auto to_cell = [](double value, double min_value, double max_value) -> uint32_t {
+        if (max_value <= min_value) {
+            return 0;
+        }
+        const double cell = (value - min_value) / (max_value - min_value) * (side - 1);
+        return std::min(static_cast<uint32_t>(std::max(cell, 0.0)), side - 1);
+    };
+    uint32_t x = to_cell(point.lng, min.lng, max.lng);
+    uint32_t y = to_cell(point.lat, min.lat, max.lat);
+
+    uint64_t index = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+        const uint32_t rx = (x & s) > 0;
+        const uint32_t ry = (y & s) > 0;
+        index += uint64_t{s} * s * ((3 * rx) ^ ry);
+        // Turns the quadrant so that the curve inside it starts where the last one ended.
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return index;
+}
+
 } //namespace geo
\ No newline at end of file
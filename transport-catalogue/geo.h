@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace geo {
 
 struct Coordinates {
@@ -9,4 +11,8 @@ struct Coordinates {
 
 double ComputeDistance(Coordinates from, Coordinates to);
 
+// Position of the point along a Hilbert curve through the box from min to max: points
+// close on the curve are close on the ground.
+uint64_t ComputeHilbertIndex(Coordinates point, Coordinates min, Coordinates max);
+
 }  // namespace geo
\ No newline at end of file
@@ -3,7 +3,12 @@
 #include "ranges.h"
 #include <graph.pb.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include <cstdlib>
+#include <limits>
+#include <stdexcept>
 #include <vector>
 #include <utility>
 
@@ -12,119 +17,231 @@ namespace graph {
 using VertexId = size_t;
 using EdgeId = size_t;
 
-template <typename Weight>
+// Width of the vertex and edge ids a graph stores. Built with TRANSPORT_CATALOGUE_INDEX32
+// they take 32 bits, which serves bases under 4G vertices and edges.
+#ifdef TRANSPORT_CATALOGUE_INDEX32
+using GraphIndex = uint32_t;
+#else
+using GraphIndex = size_t;
+#endif
+
+template <typename Weight, typename Index = VertexId>
 struct Edge {
-    VertexId from;
-    VertexId to;
+    Index from;
+    Index to;
     Weight weight;
 };
 
-template <typename Weight>
+// Edges are added with full-width ids and stored with Index ones.
+template <typename Weight, typename Index = GraphIndex>
 class DirectedWeightedGraph {
 private:
-    using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using IncidentEdgesRange = ranges::Range<typename std::vector<Index>::const_iterator>;
 
 public:
+    using StoredEdge = Edge<Weight, Index>;
+
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
+    VertexId AddVertex();
     EdgeId AddEdge(const Edge<Weight>& edge);
+    void SetEdgeWeight(EdgeId edge_id, Weight weight);
+
+    // Packs the edges leaving every vertex next to each other in compressed rows, keeping
+    // their ids. Adding an edge unpacks the graph again, and only a packed graph has
+    // incident edges to walk and can be serialized.
+    void Finalize();
+    bool IsFinalized() const;
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
-    const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+    const StoredEdge& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
     proto::DirectedWeightedGraph OutProto() const;
     void InProto(const proto::DirectedWeightedGraph& proto_directed_weighted_graph);
 
 private:
-    std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
+    std::vector<StoredEdge> edges_;
+    size_t vertex_count_ = 0;
+    // The edges leaving vertex v are incidence_edges_[incidence_offsets_[v]] up to
+    // incidence_edges_[incidence_offsets_[v + 1]].
+    std::vector<Index> incidence_offsets_;
+    std::vector<Index> incidence_edges_;
 };
 
-template <typename Weight>
-DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
+template <typename Weight, typename Index>
+DirectedWeightedGraph<Weight, Index>::DirectedWeightedGraph(size_t vertex_count)
+    : vertex_count_(vertex_count) {
+    if (vertex_count > std::numeric_limits<Index>::max()) {
+        throw std::length_error("Too many vertices for the graph's index");
+    }
 }
 
-template <typename Weight>
-EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
-    edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_.at(edge.from).push_back(id);
-    return id;
+template <typename Weight, typename Index>
+VertexId DirectedWeightedGraph<Weight, Index>::AddVertex() {
+    if (vertex_count_ == std::numeric_limits<Index>::max()) {
+        throw std::length_error("Too many vertices for the graph's index");
+    }
+    // A vertex without edges keeps the rows packed.
+    if (IsFinalized()) {
+        incidence_offsets_.push_back(incidence_offsets_.back());
+    }
+    return vertex_count_++;
 }
 
-template <typename Weight>
-size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+template <typename Weight, typename Index>
+EdgeId DirectedWeightedGraph<Weight, Index>::AddEdge(const Edge<Weight>& edge) {
+    if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+    if (edges_.size() == std::numeric_limits<Index>::max()) {
+        throw std::length_error("Too many edges for the graph's index");
+    }
+    edges_.push_back({static_cast<Index>(edge.from), static_cast<Index>(edge.to), edge.weight});
+    incidence_offsets_.clear();
+    incidence_edges_.clear();
+    return edges_.size() - 1;
 }
 
-template <typename Weight>
-size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
-    return edges_.size();
+template <typename Weight, typename Index>
+void DirectedWeightedGraph<Weight, Index>::SetEdgeWeight(EdgeId edge_id, Weight weight) {
+    edges_.at(edge_id).weight = weight;
 }
 
-template <typename Weight>
-const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
-    return edges_.at(edge_id);
+template <typename Weight, typename Index>
+void DirectedWeightedGraph<Weight, Index>::Finalize() {
+    incidence_offsets_.assign(vertex_count_ + 1, 0);
+    for (const StoredEdge& edge : edges_) {
+        ++incidence_offsets_[edge.from + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        incidence_offsets_[vertex + 1] += incidence_offsets_[vertex];
+    }
+    incidence_edges_.resize(edges_.size());
+    std::vector<Index> positions(incidence_offsets_.begin(), incidence_offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+        incidence_edges_[positions[edges_[edge_id].from]++] = edge_id;
+    }
 }
 
-template <typename Weight>
-typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
-DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+template <typename Weight, typename Index>
+bool DirectedWeightedGraph<Weight, Index>::IsFinalized() const {
+    return incidence_offsets_.size() == vertex_count_ + 1;
 }
 
-template <typename Weight>
-proto::DirectedWeightedGraph DirectedWeightedGraph<Weight>::OutProto() const {
-    proto::DirectedWeightedGraph proto_directed_weighted_graph;
+template <typename Weight, typename Index>
+size_t DirectedWeightedGraph<Weight, Index>::GetVertexCount() const {
+    return vertex_count_;
+}
 
-    for (int i = 0; i < edges_.size(); ++i) {
-        proto::Edge proto_edge;
-        proto_edge.set_from(edges_[i].from);
-        proto_edge.set_to(edges_[i].to);
-        proto_edge.set_weight(edges_[i].weight);
+template <typename Weight, typename Index>
+size_t DirectedWeightedGraph<Weight, Index>::GetEdgeCount() const {
+    return edges_.size();
+}
 
-        proto_directed_weighted_graph.add_edge();
-        *proto_directed_weighted_graph.mutable_edge(i) = std::move(proto_edge);
-    }
+template <typename Weight, typename Index>
+const typename DirectedWeightedGraph<Weight, Index>::StoredEdge&
+DirectedWeightedGraph<Weight, Index>::GetEdge(EdgeId edge_id) const {
+    return edges_[edge_id];
+}
 
-    for (int i = 0; i < incidence_lists_.size(); ++i) {
-        proto::IncidenceList proto_incidence_list;
-        for (int j = 0; j < incidence_lists_[i].size(); ++j) {
-            proto_incidence_list.add_incidence(incidence_lists_[i][j]);
-        }
+template <typename Weight, typename Index>
+typename DirectedWeightedGraph<Weight, Index>::IncidentEdgesRange
+DirectedWeightedGraph<Weight, Index>::GetIncidentEdges(VertexId vertex) const {
+    assert(IsFinalized());
+    return {incidence_edges_.begin() + incidence_offsets_[vertex],
+            incidence_edges_.begin() + incidence_offsets_[vertex + 1]};
+}
+
+template <typename Weight, typename Index>
+proto::DirectedWeightedGraph DirectedWeightedGraph<Weight, Index>::OutProto() const {
+    if (!IsFinalized()) {
+        throw std::logic_error("Graph should be finalized before serialization");
+    }
+    proto::DirectedWeightedGraph proto_directed_weighted_graph;
 
-        proto_directed_weighted_graph.add_incidence_list();
-        *proto_directed_weighted_graph.mutable_incidence_list(i) = std::move(proto_incidence_list);
+    proto_directed_weighted_graph.mutable_edge_from()->Reserve(edges_.size());
+    proto_directed_weighted_graph.mutable_edge_to()->Reserve(edges_.size());
+    proto_directed_weighted_graph.mutable_edge_weight()->Reserve(edges_.size());
+    for (const StoredEdge& edge : edges_) {
+        proto_directed_weighted_graph.add_edge_from(edge.from);
+        proto_directed_weighted_graph.add_edge_to(edge.to);
+        proto_directed_weighted_graph.add_edge_weight(edge.weight);
     }
 
+    *proto_directed_weighted_graph.mutable_incidence_offset() = {incidence_offsets_.begin(), incidence_offsets_.end()};
+    *proto_directed_weighted_graph.mutable_incidence_edge() = {incidence_edges_.begin(), incidence_edges_.end()};
+
     return proto_directed_weighted_graph;
 }
 
-template <typename Weight>
-void DirectedWeightedGraph<Weight>::InProto(const proto::DirectedWeightedGraph& proto_directed_weighted_graph) {
-    edges_.resize(proto_directed_weighted_graph.edge_size());
-    for (int i = 0; i < proto_directed_weighted_graph.edge_size(); ++i) {
-        const proto::Edge& proto_edge = proto_directed_weighted_graph.edge(i);
-
-        edges_[i] = { proto_edge.from(), proto_edge.to(), proto_edge.weight() };
+template <typename Weight, typename Index>
+void DirectedWeightedGraph<Weight, Index>::InProto(const proto::DirectedWeightedGraph& proto_directed_weighted_graph) {
+    const int edge_count = proto_directed_weighted_graph.edge_from_size();
+    const auto& proto_incidence_offsets = proto_directed_weighted_graph.incidence_offset();
+    const auto& proto_incidence_edges = proto_directed_weighted_graph.incidence_edge();
+    // A finalized graph has an offset past the last vertex even without vertices.
+    if (proto_incidence_offsets.empty()) {
+        throw std::invalid_argument("Graph has no incidence offsets");
+    }
+    if (proto_directed_weighted_graph.edge_to_size() != edge_count
+        || proto_directed_weighted_graph.edge_weight_size() != edge_count
+        || proto_incidence_edges.size() != edge_count
+        || proto_incidence_offsets[0] != 0
+        || proto_incidence_offsets[proto_incidence_offsets.size() - 1] != static_cast<uint64_t>(edge_count)) {
+        throw std::invalid_argument("Graph's edges and incidence don't match");
+    }
+    const size_t vertex_count = proto_incidence_offsets.size() - 1;
+    if (vertex_count > std::numeric_limits<Index>::max()
+        || static_cast<size_t>(edge_count) > std::numeric_limits<Index>::max()) {
+        throw std::length_error("Too many vertices for the graph's index");
+    }
+    for (int i = 1; i < proto_incidence_offsets.size(); ++i) {
+        if (proto_incidence_offsets[i] < proto_incidence_offsets[i - 1]) {
+            throw std::invalid_argument("Graph's incidence offsets decrease");
+        }
     }
 
-    incidence_lists_.resize(proto_directed_weighted_graph.incidence_list_size());
-    for (int i = 0; i < proto_directed_weighted_graph.incidence_list_size(); ++i) {
-        const proto::IncidenceList& proto_incidence_list = proto_directed_weighted_graph.incidence_list(i);
+    edges_.resize(edge_count);
+    for (int i = 0; i < edge_count; ++i) {
+        if (proto_directed_weighted_graph.edge_from(i) >= vertex_count
+            || proto_directed_weighted_graph.edge_to(i) >= vertex_count) {
+            throw std::invalid_argument("Graph's edge leads out of its vertices");
+        }
+        edges_[i] = {
+            static_cast<Index>(proto_directed_weighted_graph.edge_from(i)),
+            static_cast<Index>(proto_directed_weighted_graph.edge_to(i)),
+            static_cast<Weight>(proto_directed_weighted_graph.edge_weight(i))
+        };
+    }
+    for (const uint64_t edge_id : proto_incidence_edges) {
+        if (edge_id >= static_cast<uint64_t>(edge_count)) {
+            throw std::invalid_argument("Graph's incidence lists an unknown edge");
+        }
+    }
 
-        IncidenceList incidence_list;
-        incidence_list.reserve(proto_incidence_list.incidence_size());
+    incidence_offsets_.assign(proto_incidence_offsets.begin(), proto_incidence_offsets.end());
+    incidence_edges_.assign(proto_incidence_edges.begin(), proto_incidence_edges.end());
+    vertex_count_ = vertex_count;
+}
 
-        for (int j = 0; j < proto_incidence_list.incidence_size(); ++j) {
-            incidence_list.push_back(proto_incidence_list.incidence(j));
+template <typename Weight, typename Index>
+void CheckEdgeWeightsNonNegative(const DirectedWeightedGraph<Weight, Index>& graph) {
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < Weight{}) {
+            throw std::domain_error("Edges' weights should be non-negative");
         }
+    }
+}
 
-        incidence_lists_[i] = std::move(incidence_list);
+// Searches mark what they visit with their id, so a new search needn't clear the marks of
+// the last one. When the id wraps around, the marks are cleared once.
+template <typename SearchId, typename... Marks>
+void NextSearchId(SearchId& search_id, Marks&... marks) {
+    if (++search_id == 0) {
+        (std::fill(marks.begin(), marks.end(), SearchId{0}), ...);
+        search_id = 1;
     }
 }
 
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "graph.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace graph {
+
+class Bitset {
+public:
+    explicit Bitset(size_t size = 0)
+        : words_((size + 63) / 64, 0)
+    {
+    }
+
+    bool Test(size_t index) const {
+        return words_[index / 64] >> (index % 64) & 1;
+    }
+
+    void Set(size_t index) {
+        words_[index / 64] |= uint64_t{1} << (index % 64);
+    }
+
+    void Reset(size_t index) {
+        words_[index / 64] &= ~(uint64_t{1} << (index % 64));
+    }
+
+private:
+    std::vector<uint64_t> words_;
+};
+
+// Edges and vertices a search keeps out of. A masked vertex is neither entered nor left,
+// except that a search from it still reaches the vertex itself.
+struct GraphMask {
+    GraphMask(size_t vertex_count, size_t edge_count)
+        : vertices(vertex_count)
+        , edges(edge_count)
+    {
+    }
+
+    bool IsMasked(VertexId vertex) const {
+        return vertices.Test(vertex);
+    }
+
+    template <typename Weight, typename Index>
+    bool IsMasked(EdgeId edge_id, const Edge<Weight, Index>& edge) const {
+        return edges.Test(edge_id) || vertices.Test(edge.to);
+    }
+
+    Bitset vertices;
+    Bitset edges;
+};
+
+}  // namespace graph
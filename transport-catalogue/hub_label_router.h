@@ -0,0 +1,351 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "contraction_hierarchy.h"
+#include <router.pb.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+struct LabelStats {
+    size_t vertex_count = 0;
+    size_t forward_entry_count = 0;
+    size_t backward_entry_count = 0;
+    size_t max_forward_label_size = 0;
+    size_t max_backward_label_size = 0;
+    size_t byte_count = 0;
+};
+
+// Every vertex keeps a forward label, the weights of routes from it to a few hubs, and
+// a backward label, the weights of routes from a few hubs to it, chosen so that every
+// shortest route passes through a hub the two ends share. A query is a merge of two
+// labels sorted by hub. Labels are built by pruned Dijkstra searches from the vertices
+// taken in contraction hierarchy order, most important first. Every label entry keeps
+// the edge that leads towards its hub, which unpacks the route edge by edge.
+template <typename Weight>
+class HubLabelRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    explicit HubLabelRouter(const Graph& graph);
+    HubLabelRouter(const Graph& graph, const proto::HubLabels& proto_hub_labels);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    LabelStats GetLabelStats() const;
+
+    proto::RouterData OutProto() const override;
+    void InProto(const proto::HubLabels& proto_hub_labels);
+
+private:
+    // Labels of all vertices in compressed rows, sorted by hub within a row. A hub is
+    // identified by its position in the hub order. The edge of a forward label entry is
+    // the first edge of the route to the hub, of a backward one the last edge of the
+    // route from the hub; the entry of a vertex for itself has none.
+    struct Labels {
+        std::vector<size_t> offsets;
+        std::vector<uint32_t> hubs;
+        std::vector<Weight> weights;
+        std::vector<EdgeId> edges;
+
+        size_t Find(VertexId vertex, uint32_t hub) const {
+            const auto begin = hubs.begin() + offsets[vertex];
+            const auto end = hubs.begin() + offsets[vertex + 1];
+            return std::lower_bound(begin, end, hub) - hubs.begin();
+        }
+    };
+
+    struct LabelEntry {
+        uint32_t hub;
+        Weight weight;
+        EdgeId edge;
+    };
+
+    void BuildLabels();
+
+    static Labels FlattenLabels(const std::vector<std::vector<LabelEntry>>& labels);
+    static void OutProtoLabels(const Labels& labels, proto::Labels& proto_labels);
+    Labels InProtoLabels(const proto::Labels& proto_labels) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr EdgeId NONE_EDGE = std::numeric_limits<EdgeId>::max();
+
+    const Graph& graph_;
+    Labels forward_labels_;
+    Labels backward_labels_;
+};
+
+template <typename Weight>
+HubLabelRouter<Weight>::HubLabelRouter(const Graph& graph)
+    : graph_(graph)
+{
+    BuildLabels();
+}
+
+template <typename Weight>
+HubLabelRouter<Weight>::HubLabelRouter(const Graph& graph, const proto::HubLabels& proto_hub_labels)
+    : graph_(graph)
+{
+    InProto(proto_hub_labels);
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::BuildLabels() {
+    const size_t vertex_count = graph_.GetVertexCount();
+
+    std::vector<VertexId> hub_order(vertex_count);
+    {
+        const ContractionHierarchy<Weight> contraction_hierarchy(graph_);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            hub_order[vertex_count - 1 - contraction_hierarchy.GetRank(vertex)] = vertex;
+        }
+    }
+
+    std::vector<std::vector<EdgeId>> incoming_edges(vertex_count);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        incoming_edges[graph_.GetEdge(edge_id).to].push_back(edge_id);
+    }
+
+    std::vector<std::vector<LabelEntry>> forward_labels(vertex_count);
+    std::vector<std::vector<LabelEntry>> backward_labels(vertex_count);
+
+    using HeapItem = std::pair<Weight, VertexId>;
+    std::vector<HeapItem> heap;
+    std::vector<Weight> weights(vertex_count);
+    std::vector<EdgeId> prev_edges(vertex_count);
+    std::vector<bool> reached(vertex_count, false);
+    std::vector<bool> settled(vertex_count, false);
+    std::vector<VertexId> reached_vertices;
+    // Weights between the current hub and the hubs of its own label, by hub.
+    std::vector<std::optional<Weight>> hub_weights(vertex_count);
+
+    // Searches from the hub forward, filling backward labels, or backward, filling forward
+    // ones. A vertex whose route is already covered by earlier hubs is not expanded.
+    const auto search = [&](uint32_t hub, bool backward) {
+        const VertexId hub_vertex = hub_order[hub];
+        const auto& hub_label = backward ? backward_labels[hub_vertex] : forward_labels[hub_vertex];
+        auto& labels = backward ? forward_labels : backward_labels;
+        for (const LabelEntry& entry : hub_label) {
+            hub_weights[entry.hub] = entry.weight;
+        }
+
+        heap = {{ZERO_WEIGHT, hub_vertex}};
+        weights[hub_vertex] = ZERO_WEIGHT;
+        prev_edges[hub_vertex] = NONE_EDGE;
+        reached[hub_vertex] = true;
+        reached_vertices = {hub_vertex};
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+            const auto [weight, vertex] = heap.back();
+            heap.pop_back();
+            if (settled[vertex] || weights[vertex] < weight) {
+                continue;
+            }
+            settled[vertex] = true;
+
+            const bool covered = std::any_of(labels[vertex].begin(), labels[vertex].end(),
+                                             [&hub_weights, weight = weight](const LabelEntry& entry) {
+                return hub_weights[entry.hub] && !(weight < *hub_weights[entry.hub] + entry.weight);
+            });
+            if (covered) {
+                continue;
+            }
+            labels[vertex].push_back({hub, weight, prev_edges[vertex]});
+
+            const auto relax = [&, weight = weight](EdgeId edge_id) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                const VertexId next_vertex = backward ? edge.from : edge.to;
+                const Weight candidate_weight = weight + edge.weight;
+                if (!reached[next_vertex] || candidate_weight < weights[next_vertex]) {
+                    if (!reached[next_vertex]) {
+                        reached[next_vertex] = true;
+                        reached_vertices.push_back(next_vertex);
+                    }
+                    weights[next_vertex] = candidate_weight;
+                    prev_edges[next_vertex] = edge_id;
+                    heap.push_back({candidate_weight, next_vertex});
+                    std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+                }
+            };
+            if (backward) {
+                std::for_each(incoming_edges[vertex].begin(), incoming_edges[vertex].end(), relax);
+            } else {
+                for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                    relax(edge_id);
+                }
+            }
+        }
+
+        for (const VertexId vertex : reached_vertices) {
+            reached[vertex] = false;
+            settled[vertex] = false;
+        }
+        for (const LabelEntry& entry : hub_label) {
+            hub_weights[entry.hub].reset();
+        }
+    };
+
+    for (uint32_t hub = 0; hub < vertex_count; ++hub) {
+        search(hub, false);
+        search(hub, true);
+    }
+
+    forward_labels_ = FlattenLabels(forward_labels);
+    backward_labels_ = FlattenLabels(backward_labels);
+}
+
+template <typename Weight>
+typename HubLabelRouter<Weight>::Labels HubLabelRouter<Weight>::FlattenLabels(
+    const std::vector<std::vector<LabelEntry>>& labels)
+{
+    Labels result;
+    result.offsets.reserve(labels.size() + 1);
+    result.offsets.push_back(0);
+    for (const auto& label : labels) {
+        for (const LabelEntry& entry : label) {
+            result.hubs.push_back(entry.hub);
+            result.weights.push_back(entry.weight);
+            result.edges.push_back(entry.edge);
+        }
+        result.offsets.push_back(result.hubs.size());
+    }
+    return result;
+}
+
+template <typename Weight>
+std::optional<typename HubLabelRouter<Weight>::RouteInfo> HubLabelRouter<Weight>::BuildRoute(
+    VertexId from, VertexId to) const
+{
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+
+    std::optional<Weight> best_weight;
+    size_t best_forward = 0;
+    size_t best_backward = 0;
+    for (size_t forward = forward_labels_.offsets[from], backward = backward_labels_.offsets[to];
+         forward < forward_labels_.offsets[from + 1] && backward < backward_labels_.offsets[to + 1];)
+    {
+        if (forward_labels_.hubs[forward] < backward_labels_.hubs[backward]) {
+            ++forward;
+        } else if (backward_labels_.hubs[backward] < forward_labels_.hubs[forward]) {
+            ++backward;
+        } else {
+            const Weight weight = forward_labels_.weights[forward] + backward_labels_.weights[backward];
+            if (!best_weight || weight < *best_weight) {
+                best_weight = weight;
+                best_forward = forward;
+                best_backward = backward;
+            }
+            ++forward;
+            ++backward;
+        }
+    }
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    const uint32_t hub = forward_labels_.hubs[best_forward];
+    std::vector<EdgeId> edges;
+    for (size_t entry = best_forward; forward_labels_.edges[entry] != NONE_EDGE;) {
+        const EdgeId edge_id = forward_labels_.edges[entry];
+        edges.push_back(edge_id);
+        entry = forward_labels_.Find(graph_.GetEdge(edge_id).to, hub);
+    }
+    const size_t route_to_hub_size = edges.size();
+    for (size_t entry = best_backward; backward_labels_.edges[entry] != NONE_EDGE;) {
+        const EdgeId edge_id = backward_labels_.edges[entry];
+        edges.push_back(edge_id);
+        entry = backward_labels_.Find(graph_.GetEdge(edge_id).from, hub);
+    }
+    std::reverse(edges.begin() + route_to_hub_size, edges.end());
+
+    Weight weight = ZERO_WEIGHT;
+    for (const EdgeId edge_id : edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+    }
+    return RouteInfo{weight, std::move(edges)};
+}
+
+template <typename Weight>
+LabelStats HubLabelRouter<Weight>::GetLabelStats() const {
+    LabelStats stats;
+    stats.vertex_count = graph_.GetVertexCount();
+    stats.forward_entry_count = forward_labels_.hubs.size();
+    stats.backward_entry_count = backward_labels_.hubs.size();
+    for (VertexId vertex = 0; vertex < stats.vertex_count; ++vertex) {
+        stats.max_forward_label_size = std::max(stats.max_forward_label_size,
+                                                forward_labels_.offsets[vertex + 1] - forward_labels_.offsets[vertex]);
+        stats.max_backward_label_size = std::max(stats.max_backward_label_size,
+                                                 backward_labels_.offsets[vertex + 1] - backward_labels_.offsets[vertex]);
+    }
+    const size_t entry_byte_count = sizeof(uint32_t) + sizeof(Weight) + sizeof(EdgeId);
+    stats.byte_count = (stats.forward_entry_count + stats.backward_entry_count) * entry_byte_count
+                       + 2 * (stats.vertex_count + 1) * sizeof(size_t);
+    return stats;
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::OutProtoLabels(const Labels& labels, proto::Labels& proto_labels) {
+    for (const size_t offset : labels.offsets) {
+        proto_labels.add_offset(offset);
+    }
+    for (size_t i = 0; i < labels.hubs.size(); ++i) {
+        proto_labels.add_hub(labels.hubs[i]);
+        proto_labels.add_weight(labels.weights[i]);
+        proto_labels.add_edge(labels.edges[i] != NONE_EDGE ? labels.edges[i] + 1 : 0);
+    }
+}
+
+template <typename Weight>
+typename HubLabelRouter<Weight>::Labels HubLabelRouter<Weight>::InProtoLabels(const proto::Labels& proto_labels) const {
+    const size_t entry_count = proto_labels.hub_size();
+    if (proto_labels.offset_size() != graph_.GetVertexCount() + 1
+        || proto_labels.weight_size() != entry_count || proto_labels.edge_size() != entry_count
+        || proto_labels.offset(proto_labels.offset_size() - 1) != entry_count)
+    {
+        throw std::invalid_argument("Hub labels don't match the graph");
+    }
+
+    Labels labels;
+    labels.offsets.assign(proto_labels.offset().begin(), proto_labels.offset().end());
+    labels.hubs.assign(proto_labels.hub().begin(), proto_labels.hub().end());
+    labels.weights.assign(proto_labels.weight().begin(), proto_labels.weight().end());
+    labels.edges.resize(entry_count);
+    for (size_t i = 0; i < entry_count; ++i) {
+        const uint64_t edge = proto_labels.edge(i);
+        labels.edges[i] = edge ? edge - 1 : NONE_EDGE;
+    }
+    return labels;
+}
+
+template <typename Weight>
+proto::RouterData HubLabelRouter<Weight>::OutProto() const {
+    proto::RouterData proto_router_data;
+    proto::HubLabels& proto_hub_labels = *proto_router_data.mutable_hub_labels();
+
+    OutProtoLabels(forward_labels_, *proto_hub_labels.mutable_forward());
+    OutProtoLabels(backward_labels_, *proto_hub_labels.mutable_backward());
+
+    return proto_router_data;
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::InProto(const proto::HubLabels& proto_hub_labels) {
+    forward_labels_ = InProtoLabels(proto_hub_labels.forward());
+    backward_labels_ = InProtoLabels(proto_hub_labels.backward());
+}
+
+}  // namespace graph
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "graph.h"
+#include "graph_mask.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Dijkstra's search from one vertex that settles only the vertices within a weight
+// budget. The queue is a circle of buckets bucket_width wide, each a small heap: an edge
+// reaches no further than its weight, so the heaviest edge bounds the number of buckets
+// whatever the budget, and with a width no greater than the lightest edge pushes never
+// land in the bucket being drained, so its heap stays tiny.
+template <typename Weight>
+class IsochroneSearch {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    struct Arrival {
+        VertexId vertex;
+        Weight weight;
+    };
+
+    IsochroneSearch(const Graph& graph, Weight bucket_width);
+
+    // Vertices reached from the vertex by routes no heavier than max_weight and around the
+    // mask if there is one, in order of weight. The result is valid until the next search.
+    const std::vector<Arrival>& Search(VertexId from, Weight max_weight, const GraphMask* mask = nullptr) const;
+
+private:
+    struct HeapItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const HeapItem& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    size_t GetBucket(Weight weight) const {
+        return static_cast<size_t>(weight / bucket_width_);
+    }
+
+    void Reach(VertexId vertex, Weight weight) const {
+        search_ids_[vertex] = search_id_;
+        weights_[vertex] = weight;
+        std::vector<HeapItem>& bucket = buckets_[GetBucket(weight) % buckets_.size()];
+        ++queued_count_;
+        bucket.push_back({weight, vertex});
+        std::push_heap(bucket.begin(), bucket.end(), std::greater<HeapItem>{});
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    Weight bucket_width_;
+
+    mutable uint32_t search_id_ = 0;
+    mutable std::vector<uint32_t> search_ids_;
+    mutable std::vector<Weight> weights_;
+    mutable std::vector<std::vector<HeapItem>> buckets_;
+    mutable size_t queued_count_ = 0;
+    mutable std::vector<Arrival> arrivals_;
+};
+
+template <typename Weight>
+IsochroneSearch<Weight>::IsochroneSearch(const Graph& graph, Weight bucket_width)
+    : graph_(graph)
+    , bucket_width_(bucket_width)
+    , search_ids_(graph.GetVertexCount())
+    , weights_(graph.GetVertexCount())
+{
+    if (!(ZERO_WEIGHT < bucket_width)) {
+        throw std::invalid_argument("Bucket width should be positive");
+    }
+    CheckEdgeWeightsNonNegative(graph);
+    Weight max_edge_weight = ZERO_WEIGHT;
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        max_edge_weight = std::max(max_edge_weight, graph.GetEdge(edge_id).weight);
+    }
+    // A push lands at most ceil(max_edge_weight / bucket_width) buckets past the one
+    // drained, so that many more buckets never wrap onto it.
+    buckets_.resize(static_cast<size_t>(std::ceil(max_edge_weight / bucket_width)) + 1);
+}
+
+template <typename Weight>
+const std::vector<typename IsochroneSearch<Weight>::Arrival>& IsochroneSearch<Weight>::Search(
+    VertexId from, Weight max_weight, const GraphMask* mask) const
+{
+    if (from >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+
+    arrivals_.clear();
+    if (max_weight < ZERO_WEIGHT) {
+        return arrivals_;
+    }
+    NextSearchId(search_id_, search_ids_);
+
+    Reach(from, ZERO_WEIGHT);
+    for (size_t bucket_index = 0; queued_count_ > 0; ++bucket_index) {
+        std::vector<HeapItem>& bucket = buckets_[bucket_index % buckets_.size()];
+        while (!bucket.empty()) {
+            std::pop_heap(bucket.begin(), bucket.end(), std::greater<HeapItem>{});
+            const auto [weight, vertex] = bucket.back();
+            bucket.pop_back();
+            --queued_count_;
+            if (weights_[vertex] < weight) {
+                continue;
+            }
+            arrivals_.push_back({vertex, weight});
+            if (mask && mask->IsMasked(vertex)) {
+                continue;
+            }
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                const Weight candidate_weight = weight + edge.weight;
+                if (max_weight < candidate_weight || (mask && mask->IsMasked(edge_id, edge))) {
+                    continue;
+                }
+                if (search_ids_[edge.to] != search_id_ || candidate_weight < weights_[edge.to]) {
+                    Reach(edge.to, candidate_weight);
+                }
+            }
+        }
+    }
+    return arrivals_;
+}
+
+}  // namespace graph
@@ -1,8 +1,11 @@
 #include "json_reader.h"
 #include "json_builder.h"
 #include "graph.h"
+#include "log_duration.h"
+#include "thread_pool.h"
 #include <cassert>
 #include <algorithm>
+#include <set>
 #include <sstream>
 using namespace std;
 
@@ -38,11 +41,99 @@ map_renderer::RenderSettings CreateRenderSettings(
 transport_router::RoutingSettings CreateRoutingSettings(
     const json::Dict& routing_settings)
 {
+    transport_router::RouterType router_type = transport_router::RouterType::FLOYD;
+    if (const auto it = routing_settings.find("router_type"s); it != routing_settings.end()) {
+        router_type = StringToRouterType(it->second.AsString());
+    }
+    transport_router::GraphModel graph_model = transport_router::GraphModel::STOP_PAIRS;
+    if (const auto it = routing_settings.find("graph_model"s); it != routing_settings.end()) {
+        graph_model = StringToGraphModel(it->second.AsString());
+    }
+    size_t landmark_count = transport_router::DEFAULT_LANDMARK_COUNT;
+    if (const auto it = routing_settings.find("landmark_count"s); it != routing_settings.end()) {
+        const int count = it->second.AsInt();
+        if (count < 0) {
+            throw invalid_argument("Number of landmarks should be non-negative");
+        }
+        landmark_count = count;
+    }
+    size_t max_router_memory_mb = 0;
+    if (const auto it = routing_settings.find("max_router_memory_mb"s); it != routing_settings.end()) {
+        const int memory_mb = it->second.AsInt();
+        if (memory_mb < 0) {
+            throw invalid_argument("Router memory limit should be non-negative");
+        }
+        max_router_memory_mb = memory_mb;
+    }
     return {
         routing_settings.at("bus_wait_time"s).AsInt(),
-        routing_settings.at("bus_velocity"s).AsDouble()
+        routing_settings.at("bus_velocity"s).AsDouble(),
+        router_type,
+        landmark_count,
+        graph_model,
+        max_router_memory_mb
     };
 }
+
+transport_router::RouterType StringToRouterType(string_view router_type) {
+    if (router_type == "floyd"sv) {
+        return transport_router::RouterType::FLOYD;
+    } else if (router_type == "dijkstra"sv) {
+        return transport_router::RouterType::DIJKSTRA;
+    } else if (router_type == "floyd_float"sv) {
+        return transport_router::RouterType::FLOYD_FLOAT;
+    } else if (router_type == "floyd_fixed_point"sv) {
+        return transport_router::RouterType::FLOYD_FIXED_POINT;
+    } else if (router_type == "contraction_hierarchy"sv) {
+        return transport_router::RouterType::CONTRACTION_HIERARCHY;
+    } else if (router_type == "a_star"sv) {
+        return transport_router::RouterType::A_STAR;
+    } else if (router_type == "landmarks"sv) {
+        return transport_router::RouterType::LANDMARKS;
+    } else if (router_type == "hub_labels"sv) {
+        return transport_router::RouterType::HUB_LABELS;
+    } else if (router_type == "raptor"sv) {
+        return transport_router::RouterType::RAPTOR;
+    } else if (router_type == "csa"sv) {
+        return transport_router::RouterType::CSA;
+    }
+    throw invalid_argument("Unknown router type: "s + string(router_type));
+}
+
+string_view RouterTypeToString(transport_router::RouterType router_type) {
+    switch (router_type) {
+    case transport_router::RouterType::FLOYD:
+        return "floyd"sv;
+    case transport_router::RouterType::DIJKSTRA:
+        return "dijkstra"sv;
+    case transport_router::RouterType::FLOYD_FLOAT:
+        return "floyd_float"sv;
+    case transport_router::RouterType::FLOYD_FIXED_POINT:
+        return "floyd_fixed_point"sv;
+    case transport_router::RouterType::CONTRACTION_HIERARCHY:
+        return "contraction_hierarchy"sv;
+    case transport_router::RouterType::A_STAR:
+        return "a_star"sv;
+    case transport_router::RouterType::LANDMARKS:
+        return "landmarks"sv;
+    case transport_router::RouterType::HUB_LABELS:
+        return "hub_labels"sv;
+    case transport_router::RouterType::RAPTOR:
+        return "raptor"sv;
+    case transport_router::RouterType::CSA:
+        return "csa"sv;
+    }
+    return {};
+}
+
+transport_router::GraphModel StringToGraphModel(string_view graph_model) {
+    if (graph_model == "stop_pairs"sv) {
+        return transport_router::GraphModel::STOP_PAIRS;
+    } else if (graph_model == "line"sv) {
+        return transport_router::GraphModel::LINE;
+    }
+    throw invalid_argument("Unknown graph model: "s + string(graph_model));
+}
     
 svg::Point ArrayToPoint(const json::Array& arr) {
     assert(arr.size() == 2);
@@ -88,19 +179,27 @@ void CreateTransportCatalogueAndHandleRequests(istream& input, ostream& output)
         CreateRoutingSettings(requests.at("routing_settings"s).AsDict());
     auto [transport_catalogue, picture, transport_graph, transport_routes] = CreateTransportCatalogue(
         requests.at("base_requests"s).AsArray(), render_settings, routing_settings);
+    const auto router = transport_router::CreateRouter(
+        transport_graph,
+        transport_routes.GetRoutingSettings(),
+        CreateVertexCoordinates(transport_catalogue, transport_routes, transport_graph.GetVertexCount()));
+    const auto route_builder = CreateRouteBuilder(
+        transport_catalogue, transport_graph, transport_routes, router.get(), proto::RouterData{});
+    if (const auto it = requests.find("closures"s); it != requests.end()) {
+        route_builder->SetClosures(CreateClosures(transport_catalogue, it->second.AsDict()));
+    }
     HandleRequests(
         transport_catalogue,
         output,
         requests.at("stat_requests"s).AsArray(),
         picture,
-        transport_graph,
-        transport_routes
+        *route_builder
     );
 }
  
-tuple<TransportCatalogue, unordered_map<string_view, const domain::Stop*>,
-      map<string_view, const domain::Stop*>, map<string_view, const domain::Bus*>>
+tuple<TransportCatalogue, map<string_view, geo::Coordinates>, map<string_view, const domain::Bus*>>
 CreateStopsAndBuses(const json::Array& base_requests) {
+    log_duration::LogDuration duration("catalogue"sv);
     vector<const json::Dict*> node_stops;
     vector<const json::Dict*> node_buses;
     for (const json::Node& node_request : base_requests) {
@@ -113,11 +212,11 @@ CreateStopsAndBuses(const json::Array& base_requests) {
         }
     }
     TransportCatalogue transport_catalogue;
-    auto all_stops = CreateStops(transport_catalogue, node_stops);
+    CreateStops(transport_catalogue, node_stops);
     SetDistanceBetweenStops(transport_catalogue, node_stops);
-    auto [stops, buses] = CreateBuses(transport_catalogue, node_buses, all_stops);
-    return {move(transport_catalogue), move(all_stops),
-            move(stops), move(buses)};
+    auto [stops, buses] = CreateBuses(transport_catalogue, node_buses);
+    transport_catalogue.Finalize();
+    return {move(transport_catalogue), move(stops), move(buses)};
 }
 
 tuple<TransportCatalogue, vector<unique_ptr<svg::Drawable>>,
@@ -127,7 +226,234 @@ CreateTransportCatalogue(const json::Array& base_requests,
                          const map_renderer::RenderSettings& render_settings,
                          const transport_router::RoutingSettings& routing_settings)
 {
-    auto [transport_catalogue, all_stops, stops, buses] = CreateStopsAndBuses(base_requests);
+    auto [transport_catalogue, stops, buses] = CreateStopsAndBuses(base_requests);
+    const bool builds_edges = BuildsEdges(routing_settings);
+    // Buses get their edges, and in the line graph their on-board vertices, in the order of
+    // their names.
+    vector<size_t> bus_indexs;
+    vector<graph::VertexId> first_on_board_vertex_ids;
+    size_t vertex_count = transport_catalogue.GetStopCount();
+    if (builds_edges) {
+        for (const auto& [name, bus] : buses) {
+            bus_indexs.push_back(transport_catalogue.IndexBus(name));
+            first_on_board_vertex_ids.push_back(vertex_count);
+            vertex_count += CountOnBoardVertices(*bus, routing_settings);
+        }
+    }
+    vector<size_t> stop_index_by_vertex_id(vertex_count);
+    unordered_map<size_t, graph::VertexId> vertex_id_by_stop_index;
+    graph::VertexId next_vertex_id = 0;
+    // Stops close on the ground get close vertex ids, so searches and route tables
+    // mostly touch neighbouring memory.
+    for (const size_t index : OrderStopsAlongHilbertCurve(transport_catalogue)) {
+        vertex_id_by_stop_index.emplace(index, next_vertex_id);
+        stop_index_by_vertex_id[next_vertex_id] = index;
+        ++next_vertex_id;
+    }
+
+    // The map and the edges of every bus only read the catalogue, so they are built at the
+    // same time, each bus into a graph of its own. The map goes first, being the longest task.
+    vector<unique_ptr<svg::Drawable>> picture;
+    vector<graph::DirectedWeightedGraph<double>> bus_graphs(bus_indexs.size(),
+                                                            graph::DirectedWeightedGraph<double>(vertex_count));
+    vector<vector<transport_router::TransportRoutes::BusData>> bus_data_by_bus(bus_indexs.size());
+    {
+        log_duration::LogDuration duration("map and bus edges"sv);
+        thread_pool::ThreadPool pool;
+        pool.ParallelFor(bus_indexs.size() + 1, [&](size_t task) {
+            if (task == 0) {
+                log_duration::LogDuration map_duration("map"sv);
+                picture = CreateMap(transport_catalogue, stops, buses, render_settings);
+                return;
+            }
+            const size_t i = task - 1;
+            graph::VertexId next_on_board_vertex_id = first_on_board_vertex_ids[i];
+            AddBusEdges(
+                bus_indexs[i],
+                transport_catalogue,
+                routing_settings,
+                vertex_id_by_stop_index,
+                next_on_board_vertex_id,
+                stop_index_by_vertex_id,
+                bus_graphs[i],
+                bus_data_by_bus[i]
+            );
+        });
+    }
+
+    log_duration::LogDuration duration("graph"sv);
+    graph::DirectedWeightedGraph<double> transport_graph(vertex_count);
+    vector<transport_router::TransportRoutes::BusData> bus_data_by_edge_id;
+    for (size_t i = 0; i < bus_indexs.size(); ++i) {
+        for (graph::EdgeId edge_id = 0; edge_id < bus_graphs[i].GetEdgeCount(); ++edge_id) {
+            const auto& edge = bus_graphs[i].GetEdge(edge_id);
+            transport_graph.AddEdge({edge.from, edge.to, edge.weight});
+        }
+        bus_data_by_edge_id.insert(bus_data_by_edge_id.end(), bus_data_by_bus[i].begin(), bus_data_by_bus[i].end());
+        bus_graphs[i] = {};
+    }
+    transport_graph.Finalize();
+    // The base keeps the router type that fits into the memory limit, so that every
+    // process loading it builds the same router.
+    transport_router::RoutingSettings selected_routing_settings = routing_settings;
+    selected_routing_settings.router_type = transport_router::SelectRouterType(
+        routing_settings, transport_graph.GetVertexCount(), transport_graph.GetEdgeCount());
+    return {move(transport_catalogue), move(picture), move(transport_graph),
+            transport_router::TransportRoutes(
+                selected_routing_settings,
+                move(bus_data_by_edge_id),
+                move(stop_index_by_vertex_id),
+                move(vertex_id_by_stop_index)
+            )};
+}
+
+BaseUpdate UpdateTransportCatalogue(
+    const json::Array& base_requests,
+    TransportCatalogue& transport_catalogue,
+    graph::DirectedWeightedGraph<double>& transport_graph,
+    transport_router::TransportRoutes& transport_routes)
+{
+    vector<const json::Dict*> node_stops;
+    vector<const json::Dict*> node_new_stops;
+    vector<const json::Dict*> node_buses;
+    for (const json::Node& node_request : base_requests) {
+        const json::Dict& request = node_request.AsDict();
+        string_view type = request.at("type"s).AsString();
+        if (type == "Stop"sv) {
+            node_stops.push_back(&request);
+            if (!transport_catalogue.FindStop(request.at("name"s).AsString())) {
+                node_new_stops.push_back(&request);
+            }
+        } else if (type == "Bus"sv) {
+            if (transport_catalogue.FindBus(request.at("name"s).AsString())) {
+                throw invalid_argument("Bus "s + request.at("name"s).AsString() + " is already in the base"s);
+            }
+            node_buses.push_back(&request);
+        }
+    }
+
+    const size_t first_new_stop_index = transport_catalogue.GetStopCount();
+    CreateStops(transport_catalogue, node_new_stops);
+    // Only the buses through both stops of a changed distance can ride it.
+    set<size_t> changed_bus_indexs;
+    for (const json::Dict* node_stop : node_stops) {
+        const size_t stop_index = transport_catalogue.IndexStop(node_stop->at("name"s).AsString());
+        for (const auto& [name_other_stop, _] : node_stop->at("road_distances"s).AsDict()) {
+            const size_t other_stop_index = transport_catalogue.IndexStop(name_other_stop);
+            const auto other_bus_indexs = transport_catalogue.FindStop(other_stop_index).bus_indexs;
+            for (const size_t bus_index : transport_catalogue.FindStop(stop_index).bus_indexs) {
+                if (find(other_bus_indexs.begin(), other_bus_indexs.end(), bus_index) != other_bus_indexs.end()) {
+                    changed_bus_indexs.insert(bus_index);
+                }
+            }
+        }
+    }
+    SetDistanceBetweenStops(transport_catalogue, node_stops);
+    const size_t first_new_bus_index = transport_catalogue.GetBusCount();
+    CreateBuses(transport_catalogue, node_buses);
+    transport_catalogue.Finalize();
+
+    BaseUpdate update;
+    const transport_router::RoutingSettings& routing_settings = transport_routes.GetRoutingSettings();
+    if (!BuildsEdges(routing_settings)) {
+        return update;
+    }
+
+    unordered_map<size_t, graph::VertexId> vertex_id_by_stop_index;
+    for (size_t stop_index = 0; stop_index < first_new_stop_index; ++stop_index) {
+        vertex_id_by_stop_index.emplace(stop_index, transport_routes.GetVertexId(stop_index));
+    }
+
+    // Edges of a bus are added one after another, so the ones of a changed bus are rebuilt
+    // into a scratch graph and compared in order.
+    vector<optional<graph::EdgeId>> first_edge_by_bus(first_new_bus_index);
+    for (graph::EdgeId edge_id = transport_graph.GetEdgeCount(); edge_id-- > 0;) {
+        first_edge_by_bus[transport_routes.GetBusData(edge_id).index] = edge_id;
+    }
+    for (const size_t bus_index : changed_bus_indexs) {
+        const size_t vertex_count = transport_graph.GetVertexCount()
+                                    + CountOnBoardVertices(transport_catalogue.FindBus(bus_index), routing_settings);
+        graph::DirectedWeightedGraph<double> bus_graph(vertex_count);
+        vector<size_t> bus_stop_index_by_vertex_id(vertex_count);
+        graph::VertexId next_vertex_id = transport_graph.GetVertexCount();
+        vector<transport_router::TransportRoutes::BusData> bus_data_by_edge_id;
+        AddBusEdges(bus_index, transport_catalogue, routing_settings, vertex_id_by_stop_index,
+                    next_vertex_id, bus_stop_index_by_vertex_id, bus_graph, bus_data_by_edge_id);
+        for (graph::EdgeId i = 0; i < bus_graph.GetEdgeCount(); ++i) {
+            const graph::EdgeId edge_id = *first_edge_by_bus[bus_index] + i;
+            const double weight = bus_graph.GetEdge(i).weight;
+            const double old_weight = transport_graph.GetEdge(edge_id).weight;
+            if (weight < old_weight) {
+                update.lighter_edges.push_back(edge_id);
+            } else if (weight > old_weight) {
+                update.has_heavier_edges = true;
+            }
+            transport_graph.SetEdgeWeight(edge_id, weight);
+        }
+    }
+
+    // New vertices go after the old ones, so only the tail of the vertices' stops is filled.
+    const graph::VertexId first_new_vertex_id = transport_graph.GetVertexCount();
+    vector<size_t> stop_index_by_vertex_id(first_new_vertex_id);
+    for (size_t stop_index = first_new_stop_index; stop_index < transport_catalogue.GetStopCount(); ++stop_index) {
+        const graph::VertexId vertex_id = transport_graph.AddVertex();
+        vertex_id_by_stop_index.emplace(stop_index, vertex_id);
+        stop_index_by_vertex_id.push_back(stop_index);
+    }
+    vector<transport_router::TransportRoutes::BusData> bus_data_by_edge_id;
+    for (size_t bus_index = first_new_bus_index; bus_index < transport_catalogue.GetBusCount(); ++bus_index) {
+        graph::VertexId next_vertex_id = transport_graph.GetVertexCount();
+        const size_t on_board_vertex_count = CountOnBoardVertices(transport_catalogue.FindBus(bus_index), routing_settings);
+        for (size_t i = 0; i < on_board_vertex_count; ++i) {
+            transport_graph.AddVertex();
+        }
+        stop_index_by_vertex_id.resize(transport_graph.GetVertexCount());
+        const graph::EdgeId first_new_edge_id = transport_graph.GetEdgeCount();
+        AddBusEdges(bus_index, transport_catalogue, routing_settings, vertex_id_by_stop_index,
+                    next_vertex_id, stop_index_by_vertex_id, transport_graph, bus_data_by_edge_id);
+        for (graph::EdgeId edge_id = first_new_edge_id; edge_id < transport_graph.GetEdgeCount(); ++edge_id) {
+            update.lighter_edges.push_back(edge_id);
+        }
+    }
+    transport_graph.Finalize();
+    transport_routes.Extend(move(bus_data_by_edge_id),
+                            {stop_index_by_vertex_id.begin() + first_new_vertex_id, stop_index_by_vertex_id.end()});
+    return update;
+}
+
+vector<size_t> OrderStopsAlongHilbertCurve(const TransportCatalogue& transport_catalogue) {
+    const size_t stop_count = transport_catalogue.GetStopCount();
+    if (stop_count == 0) {
+        return {};
+    }
+    geo::Coordinates min = transport_catalogue.FindStop(0).coordinates;
+    geo::Coordinates max = min;
+    for (size_t stop_index = 1; stop_index < stop_count; ++stop_index) {
+        const geo::Coordinates& coordinates = transport_catalogue.FindStop(stop_index).coordinates;
+        min = {std::min(min.lat, coordinates.lat), std::min(min.lng, coordinates.lng)};
+        max = {std::max(max.lat, coordinates.lat), std::max(max.lng, coordinates.lng)};
+    }
+    vector<pair<uint64_t, size_t>> stops;
+    stops.reserve(stop_count);
+    for (size_t stop_index = 0; stop_index < stop_count; ++stop_index) {
+        stops.emplace_back(geo::ComputeHilbertIndex(transport_catalogue.FindStop(stop_index).coordinates, min, max),
+                           stop_index);
+    }
+    sort(stops.begin(), stops.end());
+    vector<size_t> stop_indexs;
+    stop_indexs.reserve(stop_count);
+    for (const auto& [_, stop_index] : stops) {
+        stop_indexs.push_back(stop_index);
+    }
+    return stop_indexs;
+}
+
+vector<unique_ptr<svg::Drawable>> CreateMap(
+    TransportCatalogue& transport_catalogue,
+    const map<string_view, geo::Coordinates>& stops,
+    const map<string_view, const domain::Bus*>& buses,
+    const map_renderer::RenderSettings& render_settings)
+{
     auto [min_lon, max_lon, min_lat, max_lat] = FindExtremeCoordinates(stops);
     map_renderer::ScalingPoints scaling_points(
         render_settings.width,
@@ -139,56 +465,105 @@ CreateTransportCatalogue(const json::Array& base_requests,
         max_lat
     );
     auto stops_points = ScaleStopPoints(stops, scaling_points);
-    auto picture = CreateMapObjects(transport_catalogue, stops_points, buses, render_settings);
-    graph::DirectedWeightedGraph<double> transport_graph(all_stops.size());
-    vector<size_t> stop_index_by_vertex_id(all_stops.size());
-    unordered_map<size_t, graph::VertexId> vertex_id_by_stop_index;
-    {
-        graph::VertexId i = 0;
-        for (const auto& [name, _] : all_stops) {
-            size_t index = transport_catalogue.IndexStop(name);
-            vertex_id_by_stop_index.emplace(index, i);
-            stop_index_by_vertex_id[i] = index;
-            ++i;
+    return CreateMapObjects(transport_catalogue, stops_points, buses, render_settings);
+}
+
+vector<unique_ptr<svg::Drawable>> CreateMap(
+    TransportCatalogue& transport_catalogue,
+    const map_renderer::RenderSettings& render_settings)
+{
+    map<string_view, geo::Coordinates> stops;
+    map<string_view, const domain::Bus*> buses;
+    for (size_t bus_index = 0; bus_index < transport_catalogue.GetBusCount(); ++bus_index) {
+        const domain::Bus& bus = transport_catalogue.FindBus(bus_index);
+        if (bus.stop_indexs.empty()) {
+            continue;
+        }
+        buses.emplace(bus.name, &bus);
+        for (const size_t stop_index : bus.stop_indexs) {
+            const domain::Stop stop = transport_catalogue.FindStop(stop_index);
+            stops.emplace(stop.name, stop.coordinates);
         }
     }
-    vector<transport_router::TransportRoutes::BusData> bus_data_by_edge_id;
-    for (const auto [name, bus] : buses) {
-        size_t index_bus = transport_catalogue.IndexBus(name);
-        FillingInObjectsForTransportRoutes(
-            bus->stop_indexs.begin(), bus->stop_indexs.end(),
-            index_bus,
-            transport_catalogue,
+    return CreateMap(transport_catalogue, stops, buses, render_settings);
+}
+
+bool BuildsEdges(const transport_router::RoutingSettings& routing_settings) {
+    return routing_settings.router_type != transport_router::RouterType::RAPTOR
+           && routing_settings.router_type != transport_router::RouterType::CSA;
+}
+
+size_t CountOnBoardVertices(const domain::Bus& bus, const transport_router::RoutingSettings& routing_settings) {
+    if (routing_settings.graph_model != transport_router::GraphModel::LINE) {
+        return 0;
+    }
+    return bus.ring ? bus.stop_indexs.size() : 2 * bus.stop_indexs.size();
+}
+
+void AddBusEdges(
+    size_t bus_index,
+    TransportCatalogue& transport_catalogue,
+    const transport_router::RoutingSettings& routing_settings,
+    const unordered_map<size_t, graph::VertexId>& vertex_id_by_stop_index,
+    graph::VertexId& next_vertex_id,
+    vector<size_t>& stop_index_by_vertex_id,
+    graph::DirectedWeightedGraph<double>& transport_graph,
+    vector<transport_router::TransportRoutes::BusData>& bus_data_by_edge_id)
+{
+    const domain::Bus& bus = transport_catalogue.FindBus(bus_index);
+    if (routing_settings.graph_model == transport_router::GraphModel::LINE) {
+        FillingInObjectsForLineGraph(
+            bus.stop_indexs.begin(), bus.stop_indexs.end(),
+            bus_index,
+            bus.forward_distances,
             routing_settings,
             vertex_id_by_stop_index,
+            next_vertex_id,
+            stop_index_by_vertex_id,
             transport_graph,
             bus_data_by_edge_id
         );
-        if (!bus->ring) {
-            FillingInObjectsForTransportRoutes(
-                bus->stop_indexs.rbegin(), bus->stop_indexs.rend(),
-                index_bus,
-                transport_catalogue,
+        if (!bus.ring) {
+            FillingInObjectsForLineGraph(
+                bus.stop_indexs.rbegin(), bus.stop_indexs.rend(),
+                bus_index,
+                bus.backward_distances,
                 routing_settings,
                 vertex_id_by_stop_index,
+                next_vertex_id,
+                stop_index_by_vertex_id,
                 transport_graph,
                 bus_data_by_edge_id
             );
         }
+        return;
+    }
+    FillingInObjectsForTransportRoutes(
+        bus.stop_indexs.begin(), bus.stop_indexs.end(),
+        bus_index,
+        bus.forward_distances,
+        routing_settings,
+        vertex_id_by_stop_index,
+        transport_graph,
+        bus_data_by_edge_id
+    );
+    if (!bus.ring) {
+        FillingInObjectsForTransportRoutes(
+            bus.stop_indexs.rbegin(), bus.stop_indexs.rend(),
+            bus_index,
+            bus.backward_distances,
+            routing_settings,
+            vertex_id_by_stop_index,
+            transport_graph,
+            bus_data_by_edge_id
+        );
     }
-    return {move(transport_catalogue), move(picture), move(transport_graph),
-            transport_router::TransportRoutes(
-                routing_settings,
-                move(bus_data_by_edge_id),
-                move(stop_index_by_vertex_id),
-                move(vertex_id_by_stop_index)
-            )};
 }
-    
+
 void HandleStopRequest(const TransportCatalogue& transport_catalogue, const json::Dict& stat_request, json::Builder::ArrayItemContext& response) {
     int id = stat_request.at("id"s).AsInt();
     string_view name = stat_request.at("name"s).AsString();
-    const domain::Stop* stop = transport_catalogue.FindStop(name);
+    const optional<domain::Stop> stop = transport_catalogue.FindStop(name);
 
     if (!stop) {
         response = response.Value(
@@ -275,69 +650,272 @@ void HandleMapRequest(const vector<unique_ptr<svg::Drawable>>& picture, const js
     );
 }
 
-void HandleRouteRequest(const TransportCatalogue& transport_catalogue, const graph::DirectedWeightedGraph<double>& transport_graph,
-    const transport_router::TransportRoutes& transport_routes, const graph::Router<double>& router,
-    const json::Dict& stat_request, json::Builder::ArrayItemContext& response)
+unique_ptr<transport_router::RouteBuilder> CreateRouteBuilder(
+    const TransportCatalogue& transport_catalogue,
+    const graph::DirectedWeightedGraph<double>& transport_graph,
+    const transport_router::TransportRoutes& transport_routes,
+    const graph::RouterBase<double>* router,
+    const proto::RouterData& proto_router_data)
 {
-    int id = stat_request.at("id"s).AsInt();
-    string_view from = stat_request.at("from"s).AsString();
-    string_view to = stat_request.at("to"s).AsString();
-    const auto route = router.BuildRoute(
-        transport_routes.GetVertexId(transport_catalogue.IndexStop(from)),
-        transport_routes.GetVertexId(transport_catalogue.IndexStop(to)));
+    if (router) {
+        return make_unique<transport_router::GraphRouteBuilder>(transport_graph, transport_routes, *router);
+    }
+    if (transport_routes.GetRoutingSettings().router_type == transport_router::RouterType::CSA) {
+        if (proto_router_data.has_connections()) {
+            return make_unique<csa::ConnectionScan>(transport_catalogue, proto_router_data.connections());
+        }
+        return make_unique<csa::ConnectionScan>(transport_catalogue, transport_routes.GetRoutingSettings());
+    }
+    return make_unique<raptor::Raptor>(transport_catalogue, transport_routes.GetRoutingSettings());
+}
 
+transport_router::Closures CreateClosures(const TransportCatalogue& transport_catalogue, const json::Dict& closures) {
+    transport_router::Closures result;
+    if (const auto it = closures.find("stops"s); it != closures.end()) {
+        for (const json::Node& stop : it->second.AsArray()) {
+            result.stop_indexs.push_back(transport_catalogue.IndexStop(stop.AsString()));
+        }
+    }
+    if (const auto it = closures.find("buses"s); it != closures.end()) {
+        for (const json::Node& bus : it->second.AsArray()) {
+            result.bus_indexs.push_back(transport_catalogue.IndexBus(bus.AsString()));
+        }
+    }
+    return result;
+}
+
+vector<geo::Coordinates> CreateVertexCoordinates(
+    const TransportCatalogue& transport_catalogue,
+    const transport_router::TransportRoutes& transport_routes,
+    size_t vertex_count)
+{
+    vector<geo::Coordinates> result(vertex_count);
+    for (graph::VertexId i = 0; i < vertex_count; ++i) {
+        result[i] = transport_catalogue.FindStop(transport_routes.GetStopIndex(i)).coordinates;
+    }
+    return result;
+}
+
+json::Dict CreateRouteResponse(const TransportCatalogue& transport_catalogue,
+    const optional<transport_router::Route>& route)
+{
     if (!route) {
-        response = response.Value(
-            json::Builder{}
+        return json::Builder{}
             .StartDict()
-            .Key("request_id"s).Value(id)
             .Key("error_message"s).Value("not found"s)
             .EndDict()
             .Build()
-            .AsDict()
-        );
+            .AsDict();
     }
-    else {
-        json::Builder items;
-        auto item = items.StartArray();
-        for (size_t i : route.value().edges) {
-            const auto& edge = transport_graph.GetEdge(i);
-            const auto bus_data = transport_routes.GetBusData(i);
-            item = item
-                .Value(
-                    json::Builder{}
-                    .StartDict()
-                    .Key("type"s).Value("Wait"s)
-                    .Key("stop_name"s).Value(transport_catalogue.FindStop(transport_routes.GetStopIndex(edge.from)).name)
-                    .Key("time"s).Value(transport_routes.GetRoutingSettings().bus_wait_time)
-                    .EndDict()
-                    .Build()
-                    .AsDict())
-                .Value(
-                    json::Builder{}
-                    .StartDict()
-                    .Key("type"s).Value("Bus"s)
-                    .Key("bus"s).Value(transport_catalogue.FindBus(bus_data.index).name)
-                    .Key("span_count"s).Value((int)bus_data.span_count)
-                    .Key("time"s).Value(
-                        edge.weight -
-                        transport_routes.GetRoutingSettings().bus_wait_time)
-                    .EndDict()
-                    .Build()
-                    .AsDict());
-        }
-        items = item.EndArray();
-        response = response.Value(
+
+    json::Builder items;
+    auto item = items.StartArray();
+    for (const transport_router::Ride& ride : route.value().rides) {
+        item = item
+            .Value(
+                json::Builder{}
+                .StartDict()
+                .Key("type"s).Value("Wait"s)
+                .Key("stop_name"s).Value(string(transport_catalogue.FindStop(ride.stop_index).name))
+                .Key("time"s).Value(ride.wait_weight)
+                .EndDict()
+                .Build()
+                .AsDict())
+            .Value(
+                json::Builder{}
+                .StartDict()
+                .Key("type"s).Value("Bus"s)
+                .Key("bus"s).Value(transport_catalogue.FindBus(ride.bus_index).name)
+                .Key("span_count"s).Value((int)ride.span_count)
+                .Key("time"s).Value(ride.weight - ride.wait_weight)
+                .EndDict()
+                .Build()
+                .AsDict());
+    }
+    items = item.EndArray();
+    return json::Builder{}
+        .StartDict()
+        .Key("total_time"s).Value(route.value().weight)
+        .Key("items"s).Value(items.Build().AsArray())
+        .EndDict()
+        .Build()
+        .AsDict();
+}
+
+// Route requests from one stop share a single search: the routes come back in
+// the positions of their requests. Requests with a departure time or stops and buses to
+// avoid are built one by one, and the ones asking for alternatives are left to
+// HandleAlternativeRoutesRequest.
+vector<optional<transport_router::Route>> BuildRequestedRoutes(const TransportCatalogue& transport_catalogue,
+    const json::Array& stat_requests, const transport_router::RouteBuilder& route_builder)
+{
+    map<size_t, vector<size_t>> request_positions_by_from;
+    for (size_t position = 0; position < stat_requests.size(); ++position) {
+        const json::Dict& stat_request = stat_requests[position].AsDict();
+        if (stat_request.at("type"s).AsString() == "Route"sv && !stat_request.count("alternatives"s)) {
+            request_positions_by_from[transport_catalogue.IndexStop(stat_request.at("from"s).AsString())]
+                .push_back(position);
+        }
+    }
+
+    vector<optional<transport_router::Route>> result(stat_requests.size());
+    for (auto& [from_stop_index, positions] : request_positions_by_from) {
+        const auto single_end = stable_partition(positions.begin(), positions.end(), [&stat_requests](size_t position) {
+            const json::Dict& stat_request = stat_requests[position].AsDict();
+            return stat_request.count("departure_time"s) > 0 || stat_request.count("avoid"s) > 0;
+        });
+        for (auto it = positions.begin(); it != single_end; ++it) {
+            const json::Dict& stat_request = stat_requests[*it].AsDict();
+            const size_t to_stop_index = transport_catalogue.IndexStop(stat_request.at("to"s).AsString());
+            const auto departure_time = stat_request.find("departure_time"s);
+            const double time = departure_time != stat_request.end() ? departure_time->second.AsDouble() : 0;
+            if (const auto avoid = stat_request.find("avoid"s); avoid != stat_request.end()) {
+                result[*it] = route_builder.BuildRouteAvoiding(from_stop_index, to_stop_index, time,
+                                                               CreateClosures(transport_catalogue, avoid->second.AsDict()));
+            } else {
+                result[*it] = route_builder.BuildRouteAt(from_stop_index, to_stop_index, time);
+            }
+        }
+        positions.erase(positions.begin(), single_end);
+    }
+    vector<size_t> to_stop_indexs;
+    for (const auto& [from_stop_index, positions] : request_positions_by_from) {
+        if (positions.empty()) {
+            continue;
+        }
+        to_stop_indexs.clear();
+        for (const size_t position : positions) {
+            to_stop_indexs.push_back(transport_catalogue.IndexStop(stat_requests[position].AsDict().at("to"s).AsString()));
+        }
+        vector<optional<transport_router::Route>> routes = route_builder.BuildRoutes(from_stop_index, to_stop_indexs);
+        for (size_t i = 0; i < positions.size(); ++i) {
+            result[positions[i]] = move(routes[i]);
+        }
+    }
+    return result;
+}
+
+void HandleRouteRequest(const TransportCatalogue& transport_catalogue,
+    const optional<transport_router::Route>& route, const json::Dict& stat_request, json::Builder::ArrayItemContext& response)
+{
+    json::Dict route_response = CreateRouteResponse(transport_catalogue, route);
+    route_response.emplace("request_id"s, stat_request.at("id"s).AsInt());
+    response = response.Value(move(route_response));
+}
+
+void HandleAlternativeRoutesRequest(const TransportCatalogue& transport_catalogue,
+    const transport_router::RouteBuilder& route_builder, const json::Dict& stat_request, json::Builder::ArrayItemContext& response)
+{
+    int id = stat_request.at("id"s).AsInt();
+    const int count = stat_request.at("alternatives"s).AsInt();
+    if (count < 0) {
+        throw invalid_argument("Number of alternatives should be non-negative");
+    }
+    json::Array routes;
+    for (const transport_router::Route& route : route_builder.BuildAlternativeRoutes(
+             transport_catalogue.IndexStop(stat_request.at("from"s).AsString()),
+             transport_catalogue.IndexStop(stat_request.at("to"s).AsString()),
+             count)) {
+        routes.push_back(CreateRouteResponse(transport_catalogue, route));
+    }
+    response = response.Value(
+        json::Builder{}
+        .StartDict()
+        .Key("request_id"s).Value(id)
+        .Key("routes"s).Value(move(routes))
+        .EndDict()
+        .Build()
+        .AsDict()
+    );
+}
+
+void HandleRouteMatrixRequest(const TransportCatalogue& transport_catalogue,
+    const transport_router::RouteBuilder& route_builder, const json::Dict& stat_request, json::Builder::ArrayItemContext& response)
+{
+    int id = stat_request.at("id"s).AsInt();
+    vector<size_t> to_stop_indexs;
+    for (const json::Node& to : stat_request.at("to"s).AsArray()) {
+        to_stop_indexs.push_back(transport_catalogue.IndexStop(to.AsString()));
+    }
+
+    json::Builder rows;
+    auto row = rows.StartArray();
+    for (const json::Node& from : stat_request.at("from"s).AsArray()) {
+        json::Array cells;
+        for (const auto& route : route_builder.BuildRoutes(transport_catalogue.IndexStop(from.AsString()), to_stop_indexs)) {
+            cells.push_back(CreateRouteResponse(transport_catalogue, route));
+        }
+        row = row.Value(move(cells));
+    }
+    rows = row.EndArray();
+    response = response.Value(
+        json::Builder{}
+        .StartDict()
+        .Key("request_id"s).Value(id)
+        .Key("routes"s).Value(rows.Build().AsArray())
+        .EndDict()
+        .Build()
+        .AsDict()
+    );
+}
+
+void HandleParetoRouteRequest(const TransportCatalogue& transport_catalogue,
+    const transport_router::RouteBuilder& route_builder, const json::Dict& stat_request, json::Builder::ArrayItemContext& response)
+{
+    int id = stat_request.at("id"s).AsInt();
+    json::Array routes;
+    for (const transport_router::Route& route : route_builder.BuildParetoRoutes(
+             transport_catalogue.IndexStop(stat_request.at("from"s).AsString()),
+             transport_catalogue.IndexStop(stat_request.at("to"s).AsString()))) {
+        routes.push_back(CreateRouteResponse(transport_catalogue, route));
+    }
+    response = response.Value(
+        json::Builder{}
+        .StartDict()
+        .Key("request_id"s).Value(id)
+        .Key("routes"s).Value(move(routes))
+        .EndDict()
+        .Build()
+        .AsDict()
+    );
+}
+
+void HandleReachableRequest(const TransportCatalogue& transport_catalogue,
+    const transport_router::RouteBuilder& route_builder, const json::Dict& stat_request,
+    json::Builder::ArrayItemContext& response)
+{
+    int id = stat_request.at("id"s).AsInt();
+    vector<transport_router::StopArrival> arrivals = route_builder.FindReachableStops(
+        transport_catalogue.IndexStop(stat_request.at("from"s).AsString()),
+        stat_request.at("max_time"s).AsDouble());
+    // Engines settle stops with equal times in different orders.
+    sort(arrivals.begin(), arrivals.end(), [&transport_catalogue](const auto& lhs, const auto& rhs) {
+        return pair(lhs.weight, string_view(transport_catalogue.FindStop(lhs.stop_index).name))
+             < pair(rhs.weight, string_view(transport_catalogue.FindStop(rhs.stop_index).name));
+    });
+
+    json::Builder stops;
+    auto stop = stops.StartArray();
+    for (const transport_router::StopArrival& arrival : arrivals) {
+        stop = stop.Value(
             json::Builder{}
             .StartDict()
-            .Key("request_id"s).Value(id)
-            .Key("total_time"s).Value(route.value().weight)
-            .Key("items"s).Value(items.Build().AsArray())
+            .Key("stop_name"s).Value(string(transport_catalogue.FindStop(arrival.stop_index).name))
+            .Key("time"s).Value(arrival.weight)
             .EndDict()
             .Build()
-            .AsDict()
-        );
+            .AsDict());
     }
+    stops = stop.EndArray();
+    response = response.Value(
+        json::Builder{}
+        .StartDict()
+        .Key("request_id"s).Value(id)
+        .Key("stops"s).Value(stops.Build().AsArray())
+        .EndDict()
+        .Build()
+        .AsDict()
+    );
 }
 
 void HandleRequests(
@@ -345,14 +923,15 @@ void HandleRequests(
     std::ostream& output,
     const json::Array& stat_requests,
     const vector<unique_ptr<svg::Drawable>>& picture,
-    const graph::DirectedWeightedGraph<double>& transport_graph,
-    const transport_router::TransportRoutes& transport_routes)
+    const transport_router::RouteBuilder& route_builder)
 {
-    const graph::Router router(transport_graph);
+    const vector<optional<transport_router::Route>> routes =
+        BuildRequestedRoutes(transport_catalogue, stat_requests, route_builder);
+
     json::Builder responses;
     auto response = responses.StartArray();
-    for (const json::Node& node_stat_request : stat_requests) {
-        const json::Dict& stat_request = node_stat_request.AsDict();
+    for (size_t position = 0; position < stat_requests.size(); ++position) {
+        const json::Dict& stat_request = stat_requests[position].AsDict();
         string_view type = stat_request.at("type"s).AsString();
 
         if (type == "Stop"sv) {
@@ -361,26 +940,31 @@ void HandleRequests(
             HandleBusRequest(transport_catalogue, stat_request, response);
         } else if (type == "Map"sv) {
             HandleMapRequest(picture, stat_request, response);
+        } else if (type == "Route"sv && stat_request.count("alternatives"s)) {
+            HandleAlternativeRoutesRequest(transport_catalogue, route_builder, stat_request, response);
         } else if (type == "Route"sv) {
-            HandleRouteRequest(transport_catalogue, transport_graph, transport_routes, router, stat_request, response);
+            HandleRouteRequest(transport_catalogue, routes[position], stat_request, response);
+        } else if (type == "RouteMatrix"sv) {
+            HandleRouteMatrixRequest(transport_catalogue, route_builder, stat_request, response);
+        } else if (type == "ParetoRoute"sv) {
+            HandleParetoRouteRequest(transport_catalogue, route_builder, stat_request, response);
+        } else if (type == "Reachable"sv) {
+            HandleReachableRequest(transport_catalogue, route_builder, stat_request, response);
         }
     }
     json::Print(json::Document(response.EndArray().Build()), output);
 }
     
-unordered_map<string_view, const domain::Stop*> CreateStops(
+void CreateStops(
     TransportCatalogue& transport_catalogue,
     const vector<const json::Dict*>& node_stops)
 {
-    unordered_map<string_view, const domain::Stop*> result;
     for (const json::Dict* node_stop : node_stops) {
-        const domain::Stop& stop = transport_catalogue.AddStop(
+        transport_catalogue.AddStop(
             node_stop->at("name"s).AsString(),
             {node_stop->at("latitude"s).AsDouble(), node_stop->at("longitude"s).AsDouble()}
         );
-        result.emplace(stop.name, &stop);
     }
-    return result;
 }
     
 void SetDistanceBetweenStops(
@@ -401,22 +985,42 @@ void SetDistanceBetweenStops(
     }
 }
     
-tuple<map<string_view, const domain::Stop*>, map<string_view, const domain::Bus*>>
+vector<double> CreateDepartures(const json::Dict& node_bus) {
+    vector<double> result;
+    if (const auto it = node_bus.find("departures"s); it != node_bus.end()) {
+        for (const json::Node& departure : it->second.AsArray()) {
+            result.push_back(departure.AsDouble());
+        }
+    } else if (node_bus.count("interval"s)) {
+        const double interval = node_bus.at("interval"s).AsDouble();
+        if (interval <= 0) {
+            throw invalid_argument("Bus interval should be positive");
+        }
+        const double first_departure = node_bus.at("first_departure"s).AsDouble();
+        const double last_departure = node_bus.at("last_departure"s).AsDouble();
+        for (size_t i = 0; first_departure + i * interval <= last_departure; ++i) {
+            result.push_back(first_departure + i * interval);
+        }
+    }
+    return result;
+}
+
+tuple<map<string_view, geo::Coordinates>, map<string_view, const domain::Bus*>>
 CreateBuses(
     TransportCatalogue& transport_catalogue,
-    const vector<const json::Dict*>& node_buses,
-    const unordered_map<string_view, const domain::Stop*>& stops)
+    const vector<const json::Dict*>& node_buses)
 {
-    map<string_view, const domain::Stop*> result_stops;
+    map<string_view, geo::Coordinates> result_stops;
     map<string_view, const domain::Bus*> result_buses;
     for (const json::Dict* node_bus : node_buses) {
         const json::Array& node_stops_names = node_bus->at("stops"s).AsArray();
         vector<string_view> stops_names;
         stops_names.reserve(node_stops_names.size());
         for (const json::Node& node_stop_name : node_stops_names) {
-            const domain::Stop* stop = stops.at(node_stop_name.AsString());
-            stops_names.push_back(stop->name);
-            result_stops.emplace(stop->name, stop);
+            const domain::Stop stop = transport_catalogue.FindStop(transport_catalogue.IndexStop(node_stop_name.AsString()));
+            stops_names.push_back(stop.name);
+            // Views into the catalogue's names wouldn't outlive a move of the catalogue.
+            result_stops.emplace(node_stop_name.AsString(), stop.coordinates);
         }
         bool bus_empty = stops_names.empty();
         const domain::Bus& bus = transport_catalogue.AddBus(
@@ -424,6 +1028,7 @@ CreateBuses(
             move(stops_names),
             node_bus->at("is_roundtrip"s).AsBool()
         );
+        transport_catalogue.SetBusDepartures(bus.name, CreateDepartures(*node_bus));
         if (!bus_empty) {
             result_buses.emplace(bus.name, &bus);
         }
@@ -432,31 +1037,31 @@ CreateBuses(
 }
     
 tuple<double, double, double, double> FindExtremeCoordinates(
-    const map<string_view, const domain::Stop*> stops)
+    const map<string_view, geo::Coordinates> stops)
 {
     if (stops.empty()) {
         return {0, 0, 0, 0};
     }
-    double min_lon = stops.begin()->second->coordinates.lng;
-    double max_lon = stops.begin()->second->coordinates.lng;
-    double min_lat = stops.begin()->second->coordinates.lat;
-    double max_lat = stops.begin()->second->coordinates.lat;
-    for (const auto [_, stop] : stops) {
-        min_lon = min(min_lon, stop->coordinates.lng);
-        max_lon = max(max_lon, stop->coordinates.lng);
-        min_lat = min(min_lat, stop->coordinates.lat);
-        max_lat = max(max_lat, stop->coordinates.lat);
+    double min_lon = stops.begin()->second.lng;
+    double max_lon = stops.begin()->second.lng;
+    double min_lat = stops.begin()->second.lat;
+    double max_lat = stops.begin()->second.lat;
+    for (const auto& [_, coordinates] : stops) {
+        min_lon = min(min_lon, coordinates.lng);
+        max_lon = max(max_lon, coordinates.lng);
+        min_lat = min(min_lat, coordinates.lat);
+        max_lat = max(max_lat, coordinates.lat);
     }
     return {min_lon, max_lon, min_lat, max_lat};
 }
     
 map<string_view, svg::Point> ScaleStopPoints(
-    const map<string_view, const domain::Stop*> stops,
+    const map<string_view, geo::Coordinates> stops,
     const map_renderer::ScalingPoints& scaling_points)
 {
     map<string_view, svg::Point> result;
-    for (const auto [name, stop] : stops) {
-        result.emplace(name, scaling_points.ScalePoint(stop->coordinates));
+    for (const auto& [name, coordinates] : stops) {
+        result.emplace(name, scaling_points.ScalePoint(coordinates));
     }
     return result;
 }
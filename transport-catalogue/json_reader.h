@@ -2,6 +2,8 @@
 
 #include "transport_catalogue.h"
 #include "transport_router.h"
+#include "csa.h"
+#include "raptor.h"
 #include "graph.h"
 #include "router.h"
 #include "map_renderer.h"
@@ -22,6 +24,12 @@ namespace json_reader {
 map_renderer::RenderSettings CreateRenderSettings(const json::Dict& render_settings);
     
 transport_router::RoutingSettings CreateRoutingSettings(const json::Dict& routing_settings);
+
+transport_router::RouterType StringToRouterType(std::string_view router_type);
+
+std::string_view RouterTypeToString(transport_router::RouterType router_type);
+
+transport_router::GraphModel StringToGraphModel(std::string_view graph_model);
     
 svg::Point ArrayToPoint(const json::Array& arr);
     
@@ -31,9 +39,10 @@ std::vector<svg::Color> ArrayToVectorColor(const json::Array& arr);
     
 void CreateTransportCatalogueAndHandleRequests(std::istream& input, std::ostream& output);
     
+// The catalogue, finalized, with the coordinates of the stops the buses pass and the buses
+// with stops, by name. The names of the stops are views into base_requests.
 std::tuple<TransportCatalogue,
-           std::unordered_map<std::string_view, const domain::Stop*>,
-           std::map<std::string_view, const domain::Stop*>,
+           std::map<std::string_view, geo::Coordinates>,
            std::map<std::string_view, const domain::Bus*>>
 CreateStopsAndBuses(const json::Array& base_requests);
     
@@ -43,16 +52,79 @@ std::tuple<TransportCatalogue, std::vector<std::unique_ptr<svg::Drawable>>,
 CreateTransportCatalogue(const json::Array& base_requests,
                          const map_renderer::RenderSettings& render_settings,
                          const transport_router::RoutingSettings& routing_settings);
+
+// Edges an update of the base changed: the added and lightened ones, and whether any got
+// heavier, which no table can be repaired for.
+struct BaseUpdate {
+    std::vector<graph::EdgeId> lighter_edges;
+    bool has_heavier_edges = false;
+};
+
+// Applies base requests to a built base: Stop requests add stops or change the road
+// distances of the known ones, Bus requests add buses. New vertices and edges go after
+// the old ones, and the edges of the buses over a changed distance get their new weights.
+BaseUpdate UpdateTransportCatalogue(const json::Array& base_requests,
+                                    TransportCatalogue& transport_catalogue,
+                                    graph::DirectedWeightedGraph<double>& transport_graph,
+                                    transport_router::TransportRoutes& transport_routes);
+
+// Indexes of all the stops along a Hilbert curve over their coordinates.
+std::vector<size_t> OrderStopsAlongHilbertCurve(const TransportCatalogue& transport_catalogue);
+
+std::vector<std::unique_ptr<svg::Drawable>> CreateMap(
+    TransportCatalogue& transport_catalogue,
+    const std::map<std::string_view, geo::Coordinates>& stops,
+    const std::map<std::string_view, const domain::Bus*>& buses,
+    const map_renderer::RenderSettings& render_settings);
+
+// The map of all the buses of the catalogue that have stops.
+std::vector<std::unique_ptr<svg::Drawable>> CreateMap(
+    TransportCatalogue& transport_catalogue,
+    const map_renderer::RenderSettings& render_settings);
+
+// RAPTOR and CSA ride the buses' stop sequences directly and need no edges.
+bool BuildsEdges(const transport_router::RoutingSettings& routing_settings);
+
+size_t CountOnBoardVertices(const domain::Bus& bus, const transport_router::RoutingSettings& routing_settings);
+
+// Adds the edges of the bus both ways, and in the line graph its on-board vertices from
+// next_vertex_id on, which the graph must already have.
+void AddBusEdges(
+    size_t bus_index,
+    TransportCatalogue& transport_catalogue,
+    const transport_router::RoutingSettings& routing_settings,
+    const std::unordered_map<size_t, graph::VertexId>& vertex_id_by_stop_index,
+    graph::VertexId& next_vertex_id,
+    std::vector<size_t>& stop_index_by_vertex_id,
+    graph::DirectedWeightedGraph<double>& transport_graph,
+    std::vector<transport_router::TransportRoutes::BusData>& bus_data_by_edge_id);
+    
+// Routes over the graph when there is a graph router, and with RAPTOR or CSA otherwise.
+// CSA loads its connections from the router data when there are any.
+std::unique_ptr<transport_router::RouteBuilder> CreateRouteBuilder(
+    const TransportCatalogue& transport_catalogue,
+    const graph::DirectedWeightedGraph<double>& transport_graph,
+    const transport_router::TransportRoutes& transport_routes,
+    const graph::RouterBase<double>* router,
+    const proto::RouterData& proto_router_data);
+    
+// Stops and buses by name: {"stops": [...], "buses": [...]}, either list may be left out.
+// Serves both the "closures" section and the "avoid" lists of Route requests.
+transport_router::Closures CreateClosures(const TransportCatalogue& transport_catalogue, const json::Dict& closures);
+    
+std::vector<geo::Coordinates> CreateVertexCoordinates(
+    const TransportCatalogue& transport_catalogue,
+    const transport_router::TransportRoutes& transport_routes,
+    size_t vertex_count);
     
 void HandleRequests(
     const TransportCatalogue& transport_catalogue,
     std::ostream& output,
     const json::Array& stat_requests,
     const std::vector<std::unique_ptr<svg::Drawable>>& picture,
-    const graph::DirectedWeightedGraph<double>& transport_graph,
-    const transport_router::TransportRoutes& transport_routes);
+    const transport_router::RouteBuilder& route_builder);
     
-std::unordered_map<std::string_view, const domain::Stop*> CreateStops(
+void CreateStops(
     TransportCatalogue& transport_catalogue,
     const std::vector<const json::Dict*>& stops);
    
@@ -60,18 +132,23 @@ void SetDistanceBetweenStops(
     TransportCatalogue& transport_catalogue,
     const std::vector<const json::Dict*>& stops);
     
-std::tuple<std::map<std::string_view, const domain::Stop*>,
+// Either "departures" listed one by one, or every "interval" minutes from "first_departure"
+// to "last_departure". None when the bus has neither.
+std::vector<double> CreateDepartures(const json::Dict& bus);
+
+// Buses come into the catalogue's stops and distances with Finalize. The stops are keyed
+// by the names in the requests.
+std::tuple<std::map<std::string_view, geo::Coordinates>,
            std::map<std::string_view, const domain::Bus*>>
 CreateBuses(
     TransportCatalogue& transport_catalogue,
-    const std::vector<const json::Dict*>& buses,
-    const std::unordered_map<std::string_view, const domain::Stop*>& stops);
+    const std::vector<const json::Dict*>& buses);
     
 std::tuple<double, double, double, double> FindExtremeCoordinates(
-    const std::map<std::string_view, const domain::Stop*> stops);
+    const std::map<std::string_view, geo::Coordinates> stops);
     
 std::map<std::string_view, svg::Point> ScaleStopPoints(
-    const std::map<std::string_view, const domain::Stop*> stops,
+    const std::map<std::string_view, geo::Coordinates> stops,
     const map_renderer::ScalingPoints& scaling_points);
     
 std::vector<std::unique_ptr<svg::Drawable>> CreateMapObjects(
@@ -104,34 +181,72 @@ void CreateNamesOfStops(
     const std::map<std::string_view, svg::Point> stops_points,
     const map_renderer::RenderSettings& render_settings);
     
+// distances are the road distances from first to each stop, as the bus keeps them,
+// so an edge over any number of stops weighs one subtraction.
 template<typename InputIt>
 void FillingInObjectsForTransportRoutes(
     InputIt first, InputIt last,
     size_t bus_index,
-    TransportCatalogue& transport_catalogue,
+    const std::vector<int>& distances,
     const transport_router::RoutingSettings& routing_settings,
     const std::unordered_map<size_t, graph::VertexId>& vertex_id_by_stop_name,
     graph::DirectedWeightedGraph<double>& transport_graph,
     std::vector<transport_router::TransportRoutes::BusData>& bus_data_by_edge_id)
 {
+    const double meters_per_minute = routing_settings.bus_velocity * 1000.0 / 60;
     for (auto stop1 = first; stop1 != last - 1; ++stop1) {
-        double time = routing_settings.bus_wait_time;
+        const int distance1 = distances[stop1 - first];
         for (auto stop2 = stop1 + 1; stop2 != last && *stop1 != *stop2; ++stop2) {
-            auto it = transport_catalogue.FindStop(*(stop2 - 1)).distance_to_stops.find(*stop2);
-            if (it == transport_catalogue.FindStop(*(stop2 - 1)).distance_to_stops.end()) {
-                it = transport_catalogue.FindStop(*stop2).distance_to_stops.find(*(stop2 - 1));
-            }
-            time += it->second / (routing_settings.bus_velocity * 1000.0 / 60);
             transport_graph.AddEdge({
                 vertex_id_by_stop_name.at(*stop1),
                 vertex_id_by_stop_name.at(*stop2),
-                time
+                routing_settings.bus_wait_time + (distances[stop2 - first] - distance1) / meters_per_minute
             });
             bus_data_by_edge_id.push_back({bus_index, (size_t)(stop2 - stop1)});
         }
     }
 }
     
+// Adds an on-board vertex for every stop of the bus, with boarding edges from the stops
+// weighing bus_wait_time, riding edges to the next on-board vertex and free alighting
+// edges back to the stops, so the bus takes O(L) edges instead of O(L^2).
+template<typename InputIt>
+void FillingInObjectsForLineGraph(
+    InputIt first, InputIt last,
+    size_t bus_index,
+    const std::vector<int>& distances,
+    const transport_router::RoutingSettings& routing_settings,
+    const std::unordered_map<size_t, graph::VertexId>& vertex_id_by_stop_name,
+    graph::VertexId& next_vertex_id,
+    std::vector<size_t>& stop_index_by_vertex_id,
+    graph::DirectedWeightedGraph<double>& transport_graph,
+    std::vector<transport_router::TransportRoutes::BusData>& bus_data_by_edge_id)
+{
+    using EdgeKind = transport_router::TransportRoutes::EdgeKind;
+    for (auto stop = first; stop != last; ++stop) {
+        const graph::VertexId on_board = next_vertex_id++;
+        stop_index_by_vertex_id[on_board] = *stop;
+        if (stop != first) {
+            transport_graph.AddEdge({
+                on_board - 1,
+                on_board,
+                (distances[stop - first] - distances[stop - first - 1]) / (routing_settings.bus_velocity * 1000.0 / 60)
+            });
+            bus_data_by_edge_id.push_back({bus_index, 1, EdgeKind::RIDING});
+            transport_graph.AddEdge({on_board, vertex_id_by_stop_name.at(*stop), 0});
+            bus_data_by_edge_id.push_back({bus_index, 0, EdgeKind::ALIGHTING});
+        }
+        if (stop != last - 1) {
+            transport_graph.AddEdge({
+                vertex_id_by_stop_name.at(*stop),
+                on_board,
+                static_cast<double>(routing_settings.bus_wait_time)
+            });
+            bus_data_by_edge_id.push_back({bus_index, 0, EdgeKind::BOARDING});
+        }
+    }
+}
+    
 } //namespace json_reader
     
 } //namespace transport
\ No newline at end of file
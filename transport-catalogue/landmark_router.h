@@ -0,0 +1,242 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "astar_router.h"
+#include <router.pb.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// A* with lower bounds from the triangle inequality over a few landmark vertices: a route
+// from v to t is no lighter than d(L, t) - d(L, v) nor than d(v, L) - d(t, L). The weights
+// of the routes from and to every landmark take O(kV) memory instead of Router's O(V^2).
+template <typename Weight>
+class LandmarkRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using typename RouterBase<Weight>::RouteInfo;
+
+    LandmarkRouter(const Graph& graph, size_t landmark_count);
+    LandmarkRouter(const Graph& graph, const proto::Landmarks& proto_landmarks);
+
+    LandmarkRouter(const LandmarkRouter&) = delete;
+    LandmarkRouter& operator=(const LandmarkRouter&) = delete;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    size_t GetSettledVertexCount() const override;
+
+    const std::vector<VertexId>& GetLandmarks() const;
+
+    proto::RouterData OutProto() const override;
+    void InProto(const proto::Landmarks& proto_landmarks);
+
+private:
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight UNREACHABLE_WEIGHT = std::numeric_limits<Weight>::has_infinity
+                                                 ? std::numeric_limits<Weight>::infinity()
+                                                 : std::numeric_limits<Weight>::max();
+
+    // Weights of the shortest routes from the source to every vertex, or from every vertex
+    // to the source when searching backward.
+    std::vector<Weight> ComputeWeights(VertexId source, bool backward) const;
+
+    void SelectLandmarks(size_t landmark_count);
+
+    Weight ComputeLowerBound(VertexId from, VertexId to) const;
+
+    const Graph& graph_;
+    std::vector<VertexId> landmarks_;
+    // [vertex][landmark], so that the bound for a vertex reads one contiguous row.
+    std::vector<Weight> weights_from_landmarks_;
+    std::vector<Weight> weights_to_landmarks_;
+
+    AStarRouter<Weight> router_;
+};
+
+template <typename Weight>
+LandmarkRouter<Weight>::LandmarkRouter(const Graph& graph, size_t landmark_count)
+    : graph_(graph)
+    , router_(graph, [this](VertexId from, VertexId to) { return ComputeLowerBound(from, to); })
+{
+    SelectLandmarks(landmark_count);
+}
+
+template <typename Weight>
+LandmarkRouter<Weight>::LandmarkRouter(const Graph& graph, const proto::Landmarks& proto_landmarks)
+    : graph_(graph)
+    , router_(graph, [this](VertexId from, VertexId to) { return ComputeLowerBound(from, to); })
+{
+    InProto(proto_landmarks);
+}
+
+template <typename Weight>
+std::optional<typename LandmarkRouter<Weight>::RouteInfo> LandmarkRouter<Weight>::BuildRoute(
+    VertexId from, VertexId to) const
+{
+    return router_.BuildRoute(from, to);
+}
+
+template <typename Weight>
+size_t LandmarkRouter<Weight>::GetSettledVertexCount() const {
+    return router_.GetSettledVertexCount();
+}
+
+template <typename Weight>
+const std::vector<VertexId>& LandmarkRouter<Weight>::GetLandmarks() const {
+    return landmarks_;
+}
+
+template <typename Weight>
+std::vector<Weight> LandmarkRouter<Weight>::ComputeWeights(VertexId source, bool backward) const {
+    using HeapItem = std::pair<Weight, VertexId>;
+
+    std::vector<std::vector<EdgeId>> incoming_edges;
+    if (backward) {
+        incoming_edges.resize(graph_.GetVertexCount());
+        for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+            incoming_edges[graph_.GetEdge(edge_id).to].push_back(edge_id);
+        }
+    }
+
+    std::vector<Weight> weights(graph_.GetVertexCount(), UNREACHABLE_WEIGHT);
+    std::vector<HeapItem> heap{{ZERO_WEIGHT, source}};
+    weights[source] = ZERO_WEIGHT;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+        const auto [weight, vertex] = heap.back();
+        heap.pop_back();
+        if (weights[vertex] < weight) {
+            continue;
+        }
+        const auto relax = [&, weight = weight](EdgeId edge_id) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const VertexId next_vertex = backward ? edge.from : edge.to;
+            const Weight candidate_weight = weight + edge.weight;
+            if (candidate_weight < weights[next_vertex]) {
+                weights[next_vertex] = candidate_weight;
+                heap.push_back({candidate_weight, next_vertex});
+                std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+            }
+        };
+        if (backward) {
+            std::for_each(incoming_edges[vertex].begin(), incoming_edges[vertex].end(), relax);
+        } else {
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+                relax(edge_id);
+            }
+        }
+    }
+    return weights;
+}
+
+template <typename Weight>
+void LandmarkRouter<Weight>::SelectLandmarks(size_t landmark_count) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    landmark_count = std::min(landmark_count, vertex_count);
+    landmarks_.clear();
+    weights_from_landmarks_.assign(vertex_count * landmark_count, UNREACHABLE_WEIGHT);
+    weights_to_landmarks_.assign(vertex_count * landmark_count, UNREACHABLE_WEIGHT);
+    if (landmark_count == 0) {
+        return;
+    }
+
+    // Farthest-first: every next landmark is the vertex farthest (both ways) from the ones
+    // already taken, so landmarks end up on the outskirts, behind the likely targets.
+    // Vertices unreachable from the landmarks count as the farthest.
+    std::vector<Weight> distances = ComputeWeights(0, false);
+    std::vector<bool> is_landmark(vertex_count, false);
+    for (size_t i = 0; i < landmark_count; ++i) {
+        VertexId landmark = vertex_count;
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            if (!is_landmark[vertex] && (landmark == vertex_count || distances[landmark] < distances[vertex])) {
+                landmark = vertex;
+            }
+        }
+        is_landmark[landmark] = true;
+        landmarks_.push_back(landmark);
+
+        const std::vector<Weight> weights_from = ComputeWeights(landmark, false);
+        const std::vector<Weight> weights_to = ComputeWeights(landmark, true);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            weights_from_landmarks_[vertex * landmark_count + i] = weights_from[vertex];
+            weights_to_landmarks_[vertex * landmark_count + i] = weights_to[vertex];
+
+            const Weight distance = weights_from[vertex] == UNREACHABLE_WEIGHT || weights_to[vertex] == UNREACHABLE_WEIGHT
+                                    ? UNREACHABLE_WEIGHT
+                                    : weights_from[vertex] + weights_to[vertex];
+            distances[vertex] = i == 0 ? distance : std::min(distances[vertex], distance);
+        }
+    }
+}
+
+template <typename Weight>
+Weight LandmarkRouter<Weight>::ComputeLowerBound(VertexId from, VertexId to) const {
+    const size_t landmark_count = landmarks_.size();
+    const Weight* weights_from_landmarks_to_from = weights_from_landmarks_.data() + from * landmark_count;
+    const Weight* weights_from_landmarks_to_to = weights_from_landmarks_.data() + to * landmark_count;
+    const Weight* weights_from_to_landmarks = weights_to_landmarks_.data() + from * landmark_count;
+    const Weight* weights_to_to_landmarks = weights_to_landmarks_.data() + to * landmark_count;
+
+    // Differences with an unreachable term tell nothing and are skipped.
+    Weight lower_bound = ZERO_WEIGHT;
+    for (size_t i = 0; i < landmark_count; ++i) {
+        if (weights_from_landmarks_to_from[i] != UNREACHABLE_WEIGHT
+            && weights_from_landmarks_to_to[i] != UNREACHABLE_WEIGHT)
+        {
+            lower_bound = std::max(lower_bound, weights_from_landmarks_to_to[i] - weights_from_landmarks_to_from[i]);
+        }
+        if (weights_from_to_landmarks[i] != UNREACHABLE_WEIGHT
+            && weights_to_to_landmarks[i] != UNREACHABLE_WEIGHT)
+        {
+            lower_bound = std::max(lower_bound, weights_from_to_landmarks[i] - weights_to_to_landmarks[i]);
+        }
+    }
+    return lower_bound;
+}
+
+template <typename Weight>
+proto::RouterData LandmarkRouter<Weight>::OutProto() const {
+    proto::RouterData proto_router_data;
+    proto::Landmarks& proto_landmarks = *proto_router_data.mutable_landmarks();
+
+    for (const VertexId landmark : landmarks_) {
+        proto_landmarks.add_landmark(landmark);
+    }
+    for (const Weight weight : weights_from_landmarks_) {
+        proto_landmarks.add_weight_from_landmark(weight);
+    }
+    for (const Weight weight : weights_to_landmarks_) {
+        proto_landmarks.add_weight_to_landmark(weight);
+    }
+
+    return proto_router_data;
+}
+
+template <typename Weight>
+void LandmarkRouter<Weight>::InProto(const proto::Landmarks& proto_landmarks) {
+    const size_t cell_count = graph_.GetVertexCount() * proto_landmarks.landmark_size();
+    if (proto_landmarks.weight_from_landmark_size() != cell_count
+        || proto_landmarks.weight_to_landmark_size() != cell_count)
+    {
+        throw std::invalid_argument("Landmark tables don't match the graph");
+    }
+
+    landmarks_.assign(proto_landmarks.landmark().begin(), proto_landmarks.landmark().end());
+    weights_from_landmarks_.assign(proto_landmarks.weight_from_landmark().begin(),
+                                   proto_landmarks.weight_from_landmark().end());
+    weights_to_landmarks_.assign(proto_landmarks.weight_to_landmark().begin(),
+                                 proto_landmarks.weight_to_landmark().end());
+}
+
+}  // namespace graph
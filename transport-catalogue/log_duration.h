@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace log_duration {
+
+// Prints the wall-clock time of a stage, from construction to destruction, in
+// milliseconds. Stages may run on several threads, so each prints its line at once.
+class LogDuration final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LogDuration(std::string_view stage, std::ostream& stream = std::cerr)
+        : stage_(stage)
+        , stream_(stream) {
+    }
+
+    LogDuration(const LogDuration&) = delete;
+    LogDuration& operator=(const LogDuration&) = delete;
+
+    ~LogDuration() {
+        const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time_);
+        stream_ << "Stage " + stage_ + ": " + std::to_string(duration.count()) + " ms\n";
+    }
+
+private:
+    std::string stage_;
+    std::ostream& stream_;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+} // namespace log_duration
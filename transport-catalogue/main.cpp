@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string_view>
@@ -8,11 +9,74 @@
 #include "json_reader.h"
 #include "svg.h"
 #include "map_renderer.h"
+#include "compact_router.h"
+#include "csa.h"
+#include "dijkstra_router.h"
+#include "hub_label_router.h"
+#include "log_duration.h"
 
 using namespace std::literals;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|update_base|process_requests]\n"sv;
+}
+
+constexpr size_t ROUTER_ACCURACY_SAMPLE_COUNT = 1000;
+
+void PrintRouterAccuracy(const graph::RouterAccuracy& accuracy, std::ostream& stream = std::cerr) {
+    stream << "Router accuracy against exact routes: "sv
+           << accuracy.differing_count << " of "sv << accuracy.compared_count << " sampled routes are longer, "sv
+           << "max error "sv << accuracy.max_error << " min, mean error "sv << accuracy.mean_error << " min\n"sv;
+}
+
+void PrintSearchEffort(const graph::SearchEffort& effort, std::ostream& stream = std::cerr) {
+    stream << "Router search effort: "sv << effort.settled_vertex_count << " vertices settled over "sv
+           << effort.route_count << " sampled routes, "sv << effort.dijkstra_settled_vertex_count
+           << " by Dijkstra's search\n"sv;
+}
+
+void PrintLabelStats(const graph::LabelStats& stats, std::ostream& stream = std::cerr) {
+    const double vertex_count = std::max<size_t>(1, stats.vertex_count);
+    stream << "Hub labels: "sv << stats.forward_entry_count << " forward entries (mean "sv
+           << stats.forward_entry_count / vertex_count << ", max "sv << stats.max_forward_label_size << "), "sv
+           << stats.backward_entry_count << " backward entries (mean "sv
+           << stats.backward_entry_count / vertex_count << ", max "sv << stats.max_backward_label_size << "), "sv
+           << stats.byte_count << " bytes\n"sv;
+}
+
+void PrintStopStats(const transport::StopStats& stats, std::ostream& stream = std::cerr) {
+    stream << "Stops: "sv << stats.stop_count << " stops in "sv << stats.byte_count << " bytes, "sv
+           << stats.byte_count / std::max<double>(1, stats.stop_count) << " bytes per stop\n"sv;
+}
+
+void PrintRouterSelection(const transport_router::RoutingSettings& routing_settings,
+                          transport_router::RouterType selected_router_type,
+                          size_t vertex_count, size_t edge_count, std::ostream& stream = std::cerr) {
+    constexpr double bytes_in_mb = 1024 * 1024;
+    stream << "Router "sv << transport::json_reader::RouterTypeToString(routing_settings.router_type)
+           << " would take "sv
+           << transport_router::EstimateRouterMemory(routing_settings.router_type, vertex_count, edge_count,
+                                                     routing_settings) / bytes_in_mb
+           << " MB of "sv << routing_settings.max_router_memory_mb << " MB allowed, "sv
+           << transport::json_reader::RouterTypeToString(selected_router_type) << " takes about "sv
+           << transport_router::EstimateRouterMemory(selected_router_type, vertex_count, edge_count,
+                                                     routing_settings) / bytes_in_mb
+           << " MB\n"sv;
+}
+
+// The router's precomputed data, or the connections of CSA, which routes without a graph.
+proto::RouterData CreateRouterData(const transport::TransportCatalogue& transport_catalogue,
+                                   const transport_router::RoutingSettings& routing_settings,
+                                   const graph::RouterBase<double>* router) {
+    if (router) {
+        return router->OutProto();
+    }
+    if (routing_settings.router_type == transport_router::RouterType::CSA) {
+        const csa::ConnectionScan connection_scan(transport_catalogue, routing_settings);
+        std::cerr << "Connections: "sv << connection_scan.GetConnectionCount() << '\n';
+        return connection_scan.OutProto();
+    }
+    return {};
 }
 
 int main(int argc, char* argv[]) {
@@ -24,28 +88,108 @@ int main(int argc, char* argv[]) {
     const std::string_view mode(argv[1]);
 
     if (mode == "make_base"sv) {
+        log_duration::LogDuration duration("make_base"sv);
         const auto document = json::Load(std::cin);
         const auto& requests = document.GetRoot().AsDict();
         map_renderer::RenderSettings render_settings = transport::json_reader::CreateRenderSettings(requests.at("render_settings"s).AsDict());
         transport_router::RoutingSettings routing_settings = transport::json_reader::CreateRoutingSettings(requests.at("routing_settings"s).AsDict());
         auto [transport_catalogue, picture, transport_graph, transport_routes] = transport::json_reader::CreateTransportCatalogue(
             requests.at("base_requests"s).AsArray(), render_settings, routing_settings);
+        PrintStopStats(transport_catalogue.GetStopStats());
+        if (transport_routes.GetRoutingSettings().router_type != routing_settings.router_type) {
+            PrintRouterSelection(routing_settings, transport_routes.GetRoutingSettings().router_type,
+                                 transport_graph.GetVertexCount(), transport_graph.GetEdgeCount());
+            routing_settings = transport_routes.GetRoutingSettings();
+        }
+        std::unique_ptr<graph::RouterBase<double>> router;
+        {
+            log_duration::LogDuration router_duration("router"sv);
+            router = transport_router::CreateRouter(
+                transport_graph,
+                routing_settings,
+                transport::json_reader::CreateVertexCoordinates(transport_catalogue, transport_routes, transport_graph.GetVertexCount()));
+        }
+        if (transport_router::IsApproximateRouter(routing_settings.router_type)) {
+            PrintRouterAccuracy(graph::MeasureRouterAccuracy(transport_graph, *router, ROUTER_ACCURACY_SAMPLE_COUNT));
+        }
+        if (const auto* hub_label_router = dynamic_cast<const graph::HubLabelRouter<double>*>(router.get())) {
+            PrintLabelStats(hub_label_router->GetLabelStats());
+        }
+        if (transport_router::IsSearchRouter(routing_settings.router_type)) {
+            PrintSearchEffort(graph::MeasureSearchEffort(transport_graph, *router, ROUTER_ACCURACY_SAMPLE_COUNT));
+        }
+        proto::RouterData router_data = CreateRouterData(transport_catalogue, routing_settings, router.get());
+        // The tables are in router_data now, so they aren't kept twice while the base is written.
+        router.reset();
         std::ofstream ofs(requests.at("serialization_settings"s).AsDict().at("file"s).AsString(), std::ios::binary);
-        serialization::Serialize(transport_catalogue, { std::move(picture) }, transport_graph, transport_routes, ofs);
+        serialization::Serialize(transport_catalogue, { std::move(picture) }, transport_graph, transport_routes,
+                                 std::move(router_data), ofs);
+    }
+    else if (mode == "update_base"sv) {
+        const auto document = json::Load(std::cin);
+        const auto& requests = document.GetRoot().AsDict();
+        const std::string& file = requests.at("serialization_settings"s).AsDict().at("file"s).AsString();
+
+        std::ifstream ifs(file, std::ios::binary);
+        auto [transport_catalogue, picture, transport_graph, transport_routes, router_data] = serialization::Deserialize(ifs);
+        ifs.close();
+        const transport_router::RoutingSettings routing_settings = transport_routes.GetRoutingSettings();
+        // The stored router is loaded over the graph as it was, then repaired if it can be.
+        auto router = transport_router::CreateRouter(
+            transport_graph,
+            routing_settings,
+            transport::json_reader::CreateVertexCoordinates(transport_catalogue, transport_routes, transport_graph.GetVertexCount()),
+            router_data);
+        // The router has its own copy of the stored data.
+        proto::RouterData().Swap(&router_data);
+        const auto update = transport::json_reader::UpdateTransportCatalogue(
+            requests.at("base_requests"s).AsArray(), transport_catalogue, transport_graph, transport_routes);
+        if (router && !update.has_heavier_edges && router->UpdateEdges(update.lighter_edges)) {
+            std::cerr << "Router repaired through "sv << update.lighter_edges.size() << " edges\n"sv;
+        } else if (router) {
+            router.reset();
+            router = transport_router::CreateRouter(
+                transport_graph,
+                routing_settings,
+                transport::json_reader::CreateVertexCoordinates(transport_catalogue, transport_routes, transport_graph.GetVertexCount()));
+            std::cerr << "Router rebuilt\n"sv;
+        }
+        if (const auto it = requests.find("render_settings"s); it != requests.end()) {
+            picture = transport::json_reader::CreateMap(
+                transport_catalogue, transport::json_reader::CreateRenderSettings(it->second.AsDict()));
+        }
+        router_data = CreateRouterData(transport_catalogue, routing_settings, router.get());
+        router.reset();
+        std::ofstream ofs(file, std::ios::binary);
+        serialization::Serialize(transport_catalogue, { std::move(picture) }, transport_graph, transport_routes,
+                                 std::move(router_data), ofs);
     }
     else if (mode == "process_requests"sv) {
         const auto document = json::Load(std::cin);
         const auto& requests = document.GetRoot().AsDict();
 
         std::ifstream ifs(requests.at("serialization_settings"s).AsDict().at("file"s).AsString(), std::ios::binary);
-        auto [transport_catalogue, picture, transport_graph, transport_routes] = serialization::Deserialize(ifs);
+        auto [transport_catalogue, picture, transport_graph, transport_routes, router_data] = serialization::Deserialize(ifs);
+        const auto router = transport_router::CreateRouter(
+            transport_graph,
+            transport_routes.GetRoutingSettings(),
+            transport::json_reader::CreateVertexCoordinates(transport_catalogue, transport_routes, transport_graph.GetVertexCount()),
+            router_data);
+        const auto route_builder = transport::json_reader::CreateRouteBuilder(
+            transport_catalogue, transport_graph, transport_routes, router.get(), router_data);
+        // The router and CSA copy what they need, so the stored data, as big as the tables,
+        // is freed before the requests. Clear() would keep the memory of its fields.
+        proto::RouterData().Swap(&router_data);
+        // Closures only mask the graph at query time, so the base needs no rebuild.
+        if (const auto it = requests.find("closures"s); it != requests.end()) {
+            route_builder->SetClosures(transport::json_reader::CreateClosures(transport_catalogue, it->second.AsDict()));
+        }
         transport::json_reader::HandleRequests(
             transport_catalogue,
             std::cout,
             requests.at("stat_requests"s).AsArray(),
             picture,
-            transport_graph,
-            transport_routes
+            *route_builder
         );
     }
     else {
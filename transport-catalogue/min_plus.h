@@ -0,0 +1,199 @@
+#pragma once
+
+#include "graph.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace graph {
+
+namespace min_plus {
+
+// Relaxes a row of routes through one intermediate vertex:
+// weights_from[i] = min(weights_from[i], weight_from + weights_through[i]) for i in [0, count),
+// taking the prev edge of the route through wherever the route improves.
+//
+// A route through has no prev edge only when it is the empty route of the intermediate
+// vertex itself, and that one never improves anything, so no fallback edge is needed.
+template <typename Weight>
+void RelaxRowScalar(Weight weight_from, const Weight* weights_through, const EdgeId* prev_edges_through,
+                    Weight* weights_from, EdgeId* prev_edges_from, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const Weight candidate_weight = weight_from + weights_through[i];
+        if (candidate_weight < weights_from[i]) {
+            weights_from[i] = candidate_weight;
+            prev_edges_from[i] = prev_edges_through[i];
+        }
+    }
+}
+
+template <typename Weight>
+void RelaxRow(Weight weight_from, const Weight* weights_through, const EdgeId* prev_edges_through,
+              Weight* weights_from, EdgeId* prev_edges_from, size_t count) {
+    RelaxRowScalar(weight_from, weights_through, prev_edges_through, weights_from, prev_edges_from, count);
+}
+
+static_assert(sizeof(EdgeId) == 8, "Vector kernels blend prev edges as 64-bit lanes");
+
+#if defined(__AVX2__)
+
+inline void BlendPrevEdges(__m256i mask_low, __m256i mask_high, const EdgeId* prev_edges_through,
+                           EdgeId* prev_edges_from) {
+    const __m256i* through = reinterpret_cast<const __m256i*>(prev_edges_through);
+    __m256i* from = reinterpret_cast<__m256i*>(prev_edges_from);
+    _mm256_storeu_si256(from, _mm256_blendv_epi8(_mm256_loadu_si256(from), _mm256_loadu_si256(through), mask_low));
+    _mm256_storeu_si256(from + 1, _mm256_blendv_epi8(_mm256_loadu_si256(from + 1), _mm256_loadu_si256(through + 1), mask_high));
+}
+
+inline void BlendPrevEdges(__m256i mask, const EdgeId* prev_edges_through, EdgeId* prev_edges_from) {
+    BlendPrevEdges(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask)),
+                   _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1)),
+                   prev_edges_through, prev_edges_from);
+}
+
+template <>
+inline void RelaxRow<float>(float weight_from, const float* weights_through, const EdgeId* prev_edges_through,
+                            float* weights_from, EdgeId* prev_edges_from, size_t count) {
+    const __m256 weight_from_x8 = _mm256_set1_ps(weight_from);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 current = _mm256_loadu_ps(weights_from + i);
+        const __m256 candidate = _mm256_add_ps(weight_from_x8, _mm256_loadu_ps(weights_through + i));
+        const __m256 mask = _mm256_cmp_ps(candidate, current, _CMP_LT_OQ);
+        if (_mm256_movemask_ps(mask) == 0) {
+            continue;
+        }
+        _mm256_storeu_ps(weights_from + i, _mm256_blendv_ps(current, candidate, mask));
+        BlendPrevEdges(_mm256_castps_si256(mask), prev_edges_through + i, prev_edges_from + i);
+    }
+    RelaxRowScalar(weight_from, weights_through + i, prev_edges_through + i,
+                   weights_from + i, prev_edges_from + i, count - i);
+}
+
+template <>
+inline void RelaxRow<int32_t>(int32_t weight_from, const int32_t* weights_through, const EdgeId* prev_edges_through,
+                              int32_t* weights_from, EdgeId* prev_edges_from, size_t count) {
+    const __m256i weight_from_x8 = _mm256_set1_epi32(weight_from);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_from + i));
+        const __m256i candidate = _mm256_add_epi32(
+            weight_from_x8, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights_through + i)));
+        const __m256i mask = _mm256_cmpgt_epi32(current, candidate);
+        if (_mm256_movemask_epi8(mask) == 0) {
+            continue;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(weights_from + i), _mm256_blendv_epi8(current, candidate, mask));
+        BlendPrevEdges(mask, prev_edges_through + i, prev_edges_from + i);
+    }
+    RelaxRowScalar(weight_from, weights_through + i, prev_edges_through + i,
+                   weights_from + i, prev_edges_from + i, count - i);
+}
+
+template <>
+inline void RelaxRow<double>(double weight_from, const double* weights_through, const EdgeId* prev_edges_through,
+                             double* weights_from, EdgeId* prev_edges_from, size_t count) {
+    const __m256d weight_from_x4 = _mm256_set1_pd(weight_from);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256d current = _mm256_loadu_pd(weights_from + i);
+        const __m256d candidate = _mm256_add_pd(weight_from_x4, _mm256_loadu_pd(weights_through + i));
+        const __m256d mask = _mm256_cmp_pd(candidate, current, _CMP_LT_OQ);
+        if (_mm256_movemask_pd(mask) == 0) {
+            continue;
+        }
+        _mm256_storeu_pd(weights_from + i, _mm256_blendv_pd(current, candidate, mask));
+        __m256i* from = reinterpret_cast<__m256i*>(prev_edges_from + i);
+        _mm256_storeu_si256(from, _mm256_blendv_epi8(
+            _mm256_loadu_si256(from),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_edges_through + i)),
+            _mm256_castpd_si256(mask)));
+    }
+    RelaxRowScalar(weight_from, weights_through + i, prev_edges_through + i,
+                   weights_from + i, prev_edges_from + i, count - i);
+}
+
+#elif defined(__SSE2__)
+
+inline __m128i Blend(__m128i mask, __m128i if_false, __m128i if_true) {
+    return _mm_or_si128(_mm_and_si128(mask, if_true), _mm_andnot_si128(mask, if_false));
+}
+
+inline void BlendPrevEdges(__m128i mask, const EdgeId* prev_edges_through, EdgeId* prev_edges_from) {
+    const __m128i* through = reinterpret_cast<const __m128i*>(prev_edges_through);
+    __m128i* from = reinterpret_cast<__m128i*>(prev_edges_from);
+    _mm_storeu_si128(from, Blend(_mm_unpacklo_epi32(mask, mask), _mm_loadu_si128(from), _mm_loadu_si128(through)));
+    _mm_storeu_si128(from + 1, Blend(_mm_unpackhi_epi32(mask, mask), _mm_loadu_si128(from + 1), _mm_loadu_si128(through + 1)));
+}
+
+template <>
+inline void RelaxRow<float>(float weight_from, const float* weights_through, const EdgeId* prev_edges_through,
+                            float* weights_from, EdgeId* prev_edges_from, size_t count) {
+    const __m128 weight_from_x4 = _mm_set1_ps(weight_from);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 current = _mm_loadu_ps(weights_from + i);
+        const __m128 candidate = _mm_add_ps(weight_from_x4, _mm_loadu_ps(weights_through + i));
+        const __m128 mask = _mm_cmplt_ps(candidate, current);
+        if (_mm_movemask_ps(mask) == 0) {
+            continue;
+        }
+        _mm_storeu_ps(weights_from + i, _mm_or_ps(_mm_and_ps(mask, candidate), _mm_andnot_ps(mask, current)));
+        BlendPrevEdges(_mm_castps_si128(mask), prev_edges_through + i, prev_edges_from + i);
+    }
+    RelaxRowScalar(weight_from, weights_through + i, prev_edges_through + i,
+                   weights_from + i, prev_edges_from + i, count - i);
+}
+
+template <>
+inline void RelaxRow<int32_t>(int32_t weight_from, const int32_t* weights_through, const EdgeId* prev_edges_through,
+                              int32_t* weights_from, EdgeId* prev_edges_from, size_t count) {
+    const __m128i weight_from_x4 = _mm_set1_epi32(weight_from);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights_from + i));
+        const __m128i candidate = _mm_add_epi32(
+            weight_from_x4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights_through + i)));
+        const __m128i mask = _mm_cmplt_epi32(candidate, current);
+        if (_mm_movemask_epi8(mask) == 0) {
+            continue;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(weights_from + i), Blend(mask, current, candidate));
+        BlendPrevEdges(mask, prev_edges_through + i, prev_edges_from + i);
+    }
+    RelaxRowScalar(weight_from, weights_through + i, prev_edges_through + i,
+                   weights_from + i, prev_edges_from + i, count - i);
+}
+
+template <>
+inline void RelaxRow<double>(double weight_from, const double* weights_through, const EdgeId* prev_edges_through,
+                             double* weights_from, EdgeId* prev_edges_from, size_t count) {
+    const __m128d weight_from_x2 = _mm_set1_pd(weight_from);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128d current = _mm_loadu_pd(weights_from + i);
+        const __m128d candidate = _mm_add_pd(weight_from_x2, _mm_loadu_pd(weights_through + i));
+        const __m128d mask = _mm_cmplt_pd(candidate, current);
+        if (_mm_movemask_pd(mask) == 0) {
+            continue;
+        }
+        _mm_storeu_pd(weights_from + i, _mm_or_pd(_mm_and_pd(mask, candidate), _mm_andnot_pd(mask, current)));
+        __m128i* from = reinterpret_cast<__m128i*>(prev_edges_from + i);
+        _mm_storeu_si128(from, Blend(_mm_castpd_si128(mask), _mm_loadu_si128(from),
+                                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_edges_through + i))));
+    }
+    RelaxRowScalar(weight_from, weights_through + i, prev_edges_through + i,
+                   weights_from + i, prev_edges_from + i, count - i);
+}
+
+#endif
+
+}  // namespace min_plus
+
+}  // namespace graph
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "graph.h"
+#include "graph_mask.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Routes optimal in two criteria at once: the weight and a small integer count added by
+// every edge, such as the number of buses taken. One label-setting search finds the whole
+// Pareto set: the lightest route for every count that makes it lighter.
+//
+// Labels are settled in order of (weight, count), so a label is Pareto-optimal at its vertex
+// exactly when its count is below the counts of the labels settled there before it: the bag
+// of a vertex prunes down to that one minimum. Labels live in one pool and point to their
+// parents.
+template <typename Weight>
+class ParetoRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    struct RouteInfo {
+        Weight weight;
+        uint32_t count;
+        std::vector<EdgeId> edges;
+    };
+
+    ParetoRouter(const Graph& graph, std::vector<uint32_t> edge_counts);
+
+    // Pareto-optimal routes in order of count, so every next one is lighter. Routes keep
+    // out of the mask if there is one.
+    std::vector<RouteInfo> BuildRoutes(VertexId from, VertexId to, const GraphMask* mask = nullptr) const;
+
+private:
+    static constexpr uint32_t NONE_LABEL = std::numeric_limits<uint32_t>::max();
+    static constexpr uint32_t INFINITE_COUNT = std::numeric_limits<uint32_t>::max();
+
+    struct Label {
+        Weight weight;
+        uint32_t count;
+        VertexId vertex;
+        EdgeId edge;
+        uint32_t parent;
+    };
+
+    // The heap is of pool indices; greater in (weight, count) goes down.
+    bool IsHeavier(uint32_t lhs, uint32_t rhs) const {
+        const Label& lhs_label = labels_[lhs];
+        const Label& rhs_label = labels_[rhs];
+        return std::pair(lhs_label.weight, lhs_label.count) > std::pair(rhs_label.weight, rhs_label.count);
+    }
+
+    uint32_t GetMinCount(VertexId vertex) const {
+        return search_ids_[vertex] == search_id_ ? min_counts_[vertex] : INFINITE_COUNT;
+    }
+
+    void Push(const Label& label) const {
+        labels_.push_back(label);
+        heap_.push_back(static_cast<uint32_t>(labels_.size() - 1));
+        std::push_heap(heap_.begin(), heap_.end(), [this](uint32_t lhs, uint32_t rhs) { return IsHeavier(lhs, rhs); });
+    }
+
+    const Graph& graph_;
+    std::vector<uint32_t> edge_counts_;
+
+    mutable uint32_t search_id_ = 0;
+    mutable std::vector<uint32_t> search_ids_;
+    // The least count among the labels settled at a vertex.
+    mutable std::vector<uint32_t> min_counts_;
+    mutable std::vector<Label> labels_;
+    mutable std::vector<uint32_t> heap_;
+};
+
+template <typename Weight>
+ParetoRouter<Weight>::ParetoRouter(const Graph& graph, std::vector<uint32_t> edge_counts)
+    : graph_(graph)
+    , edge_counts_(std::move(edge_counts))
+    , search_ids_(graph.GetVertexCount())
+    , min_counts_(graph.GetVertexCount())
+{
+    if (edge_counts_.size() != graph.GetEdgeCount()) {
+        throw std::invalid_argument("Edge counts don't match the graph");
+    }
+    CheckEdgeWeightsNonNegative(graph);
+}
+
+template <typename Weight>
+std::vector<typename ParetoRouter<Weight>::RouteInfo> ParetoRouter<Weight>::BuildRoutes(
+    VertexId from, VertexId to, const GraphMask* mask) const
+{
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+
+    NextSearchId(search_id_, search_ids_);
+    labels_.clear();
+    heap_.clear();
+    Push({Weight{}, 0, from, 0, NONE_LABEL});
+
+    std::vector<uint32_t> target_labels;
+    const auto is_heavier = [this](uint32_t lhs, uint32_t rhs) { return IsHeavier(lhs, rhs); };
+    while (!heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), is_heavier);
+        const uint32_t label_index = heap_.back();
+        heap_.pop_back();
+        const Label label = labels_[label_index];
+        // Labels settled at the target are no heavier, so one with no smaller count is useless.
+        if (label.count >= GetMinCount(label.vertex) || label.count >= GetMinCount(to)) {
+            continue;
+        }
+        search_ids_[label.vertex] = search_id_;
+        min_counts_[label.vertex] = label.count;
+        if (label.vertex == to) {
+            target_labels.push_back(label_index);
+            if (label.count == 0) {
+                break;
+            }
+            continue;
+        }
+        if (mask && mask->IsMasked(label.vertex)) {
+            continue;
+        }
+
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(label.vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (mask && mask->IsMasked(edge_id, edge)) {
+                continue;
+            }
+            const uint32_t count = label.count + edge_counts_[edge_id];
+            if (count < GetMinCount(edge.to) && count < GetMinCount(to)) {
+                Push({label.weight + edge.weight, count, edge.to, edge_id, label_index});
+            }
+        }
+    }
+
+    // Settled later means heavier but with a smaller count.
+    std::vector<RouteInfo> routes;
+    routes.reserve(target_labels.size());
+    for (auto it = target_labels.rbegin(); it != target_labels.rend(); ++it) {
+        RouteInfo route{labels_[*it].weight, labels_[*it].count, {}};
+        for (uint32_t label_index = *it; labels_[label_index].parent != NONE_LABEL;
+             label_index = labels_[label_index].parent)
+        {
+            route.edges.push_back(labels_[label_index].edge);
+        }
+        std::reverse(route.edges.begin(), route.edges.end());
+        routes.push_back(std::move(route));
+    }
+    return routes;
+}
+
+}  // namespace graph
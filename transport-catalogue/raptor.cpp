@@ -0,0 +1,245 @@
+#include "raptor.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+using namespace std;
+
+namespace raptor {
+
+namespace {
+
+constexpr size_t NONE_POSITION = numeric_limits<size_t>::max();
+constexpr size_t NONE_STOP = numeric_limits<size_t>::max();
+
+} // namespace
+
+Raptor::Raptor(const transport::TransportCatalogue& transport_catalogue,
+               const transport_router::RoutingSettings& routing_settings)
+: bus_wait_time_(routing_settings.bus_wait_time)
+, bus_velocity_(routing_settings.bus_velocity)
+, closures_(transport_catalogue.GetStopCount(), transport_catalogue.GetBusCount()) {
+    for (size_t bus_index = 0; bus_index < transport_catalogue.GetBusCount(); ++bus_index) {
+        const domain::Bus& bus = transport_catalogue.FindBus(bus_index);
+        AddLine(bus_index, bus.stop_indexs, bus.forward_distances);
+        if (!bus.ring) {
+            AddLine(bus_index, {bus.stop_indexs.rbegin(), bus.stop_indexs.rend()}, bus.backward_distances);
+        }
+    }
+
+    const size_t stop_count = transport_catalogue.GetStopCount();
+    stop_line_offsets_.assign(stop_count + 1, 0);
+    for (const size_t stop_index : line_stops_) {
+        ++stop_line_offsets_[stop_index + 1];
+    }
+    for (size_t i = 0; i < stop_count; ++i) {
+        stop_line_offsets_[i + 1] += stop_line_offsets_[i];
+    }
+    stop_lines_.resize(line_stops_.size());
+    vector<size_t> stop_line_positions(stop_line_offsets_.begin(), stop_line_offsets_.end() - 1);
+    for (size_t line_index = 0; line_index < lines_.size(); ++line_index) {
+        const Line& line = lines_[line_index];
+        for (size_t position = 0; position < line.stop_count; ++position) {
+            const size_t stop_index = line_stops_[line.offset + position];
+            stop_lines_[stop_line_positions[stop_index]++] = {line_index, position};
+        }
+    }
+
+    best_weights_.resize(stop_count);
+    marked_.assign(stop_count, false);
+    first_line_positions_.assign(lines_.size(), NONE_POSITION);
+}
+
+void Raptor::AddLine(size_t bus_index, vector<size_t> stop_indexs, const vector<int>& distances) {
+    lines_.push_back({bus_index, line_stops_.size(), stop_indexs.size()});
+    for (size_t i = 0; i < stop_indexs.size(); ++i) {
+        double segment_weight = 0;
+        if (i > 0) {
+            segment_weight = (distances[i] - distances[i - 1]) / (bus_velocity_ * 1000.0 / 60);
+        }
+        line_stops_.push_back(stop_indexs[i]);
+        segment_weights_.push_back(segment_weight);
+    }
+}
+
+void Raptor::ScanLine(size_t line_index, size_t first_position, size_t round, size_t to_stop_index,
+                      double max_weight) const {
+    const Line& line = lines_[line_index];
+    const vector<optional<Label>>& prev_labels = labels_[round - 1];
+    vector<optional<Label>>& labels = labels_[round];
+
+    bool boarded = false;
+    size_t board_position = 0;
+    double board_weight = 0;
+    double ride_weight = 0;
+    for (size_t position = first_position; position < line.stop_count; ++position) {
+        const size_t stop_index = line_stops_[line.offset + position];
+        const bool is_closed = closures_.IsStopClosed(stop_index);
+        if (boarded) {
+            ride_weight += segment_weights_[line.offset + position];
+            // A ride ends once the bus comes back to the stop it was boarded at.
+            if (stop_index == line_stops_[line.offset + board_position]) {
+                boarded = false;
+            } else if (!is_closed) {
+                const double weight = board_weight + ride_weight;
+                if (weight <= max_weight && weight < best_weights_[stop_index]
+                    && (to_stop_index == NONE_STOP || weight < best_weights_[to_stop_index])) {
+                    best_weights_[stop_index] = weight;
+                    labels[stop_index] = Label{weight, line_index, board_position, position, ride_weight};
+                    if (!marked_[stop_index]) {
+                        marked_[stop_index] = true;
+                        marked_stops_.push_back(stop_index);
+                    }
+                }
+            }
+        }
+        if (prev_labels[stop_index] && !is_closed
+            && (!boarded || prev_labels[stop_index]->weight + bus_wait_time_ < board_weight + ride_weight)) {
+            boarded = true;
+            board_position = position;
+            board_weight = prev_labels[stop_index]->weight;
+            ride_weight = bus_wait_time_;
+        }
+    }
+}
+
+optional<transport_router::Route> Raptor::BuildRoute(size_t from_stop_index, size_t to_stop_index) const {
+    if (to_stop_index >= best_weights_.size()) {
+        throw out_of_range("Stop is out of range");
+    }
+    const size_t round = Search(from_stop_index, to_stop_index);
+    return ExtractRoute(to_stop_index, round);
+}
+
+vector<optional<transport_router::Route>> Raptor::BuildRoutes(
+    size_t from_stop_index, const vector<size_t>& to_stop_indexs) const {
+    for (const size_t to_stop_index : to_stop_indexs) {
+        if (to_stop_index >= best_weights_.size()) {
+            throw out_of_range("Stop is out of range");
+        }
+    }
+    const size_t round = Search(from_stop_index, NONE_STOP);
+
+    vector<optional<transport_router::Route>> routes;
+    routes.reserve(to_stop_indexs.size());
+    for (const size_t to_stop_index : to_stop_indexs) {
+        routes.push_back(ExtractRoute(to_stop_index, round));
+    }
+    return routes;
+}
+
+vector<transport_router::StopArrival> Raptor::FindReachableStops(size_t from_stop_index, double max_weight) const {
+    vector<transport_router::StopArrival> result;
+    if (max_weight < 0) {
+        return result;
+    }
+    Search(from_stop_index, NONE_STOP, max_weight);
+    for (size_t stop_index = 0; stop_index < best_weights_.size(); ++stop_index) {
+        if (best_weights_[stop_index] <= max_weight) {
+            result.push_back({stop_index, best_weights_[stop_index]});
+        }
+    }
+    return result;
+}
+
+vector<transport_router::Route> Raptor::BuildParetoRoutes(size_t from_stop_index, size_t to_stop_index) const {
+    if (to_stop_index >= best_weights_.size()) {
+        throw out_of_range("Stop is out of range");
+    }
+    const size_t last_round = Search(from_stop_index, to_stop_index);
+
+    vector<transport_router::Route> routes;
+    for (size_t round = 0; round <= last_round; ++round) {
+        if (labels_[round][to_stop_index]) {
+            routes.push_back(*ExtractRoute(to_stop_index, round));
+        }
+    }
+    return routes;
+}
+
+void Raptor::SetClosures(const transport_router::Closures& closures) {
+    closures_.Set(closures);
+}
+
+optional<transport_router::Route> Raptor::BuildRouteAvoiding(size_t from_stop_index, size_t to_stop_index,
+                                                             double departure_time,
+                                                             const transport_router::Closures& avoid) const {
+    if (from_stop_index >= best_weights_.size() || to_stop_index >= best_weights_.size()) {
+        throw out_of_range("Stop is out of range");
+    }
+    const transport_router::Closures added = closures_.Add(avoid);
+    auto route = BuildRouteAt(from_stop_index, to_stop_index, departure_time);
+    closures_.Reopen(added);
+    return route;
+}
+
+size_t Raptor::Search(size_t from_stop_index, size_t to_stop_index, double max_weight) const {
+    const size_t stop_count = best_weights_.size();
+    if (from_stop_index >= stop_count) {
+        throw out_of_range("Stop is out of range");
+    }
+
+    fill(best_weights_.begin(), best_weights_.end(), numeric_limits<double>::infinity());
+    if (labels_.empty()) {
+        labels_.emplace_back();
+    }
+    labels_[0].assign(stop_count, nullopt);
+    labels_[0][from_stop_index] = Label{0, 0, 0, 0, 0};
+    best_weights_[from_stop_index] = 0;
+    marked_stops_ = {from_stop_index};
+
+    size_t round = 0;
+    while (!marked_stops_.empty()) {
+        ++round;
+        if (labels_.size() <= round) {
+            labels_.emplace_back();
+        }
+        labels_[round].assign(stop_count, nullopt);
+
+        for (const size_t stop_index : marked_stops_) {
+            marked_[stop_index] = false;
+            for (size_t i = stop_line_offsets_[stop_index]; i < stop_line_offsets_[stop_index + 1]; ++i) {
+                const auto [line_index, position] = stop_lines_[i];
+                if (closures_.IsBusClosed(lines_[line_index].bus_index)) {
+                    continue;
+                }
+                if (first_line_positions_[line_index] == NONE_POSITION) {
+                    scanned_lines_.push_back(line_index);
+                }
+                first_line_positions_[line_index] = min(first_line_positions_[line_index], position);
+            }
+        }
+        marked_stops_.clear();
+
+        for (const size_t line_index : scanned_lines_) {
+            ScanLine(line_index, first_line_positions_[line_index], round, to_stop_index, max_weight);
+            first_line_positions_[line_index] = NONE_POSITION;
+        }
+        scanned_lines_.clear();
+    }
+
+    return round;
+}
+
+optional<transport_router::Route> Raptor::ExtractRoute(size_t to_stop_index, size_t round) const {
+    if (best_weights_[to_stop_index] == numeric_limits<double>::infinity()) {
+        return nullopt;
+    }
+
+    // The last round that improved the route to the stop holds the best one.
+    while (!labels_[round][to_stop_index]) {
+        --round;
+    }
+    transport_router::Route route{labels_[round][to_stop_index]->weight, {}};
+    for (size_t stop_index = to_stop_index; round > 0; --round) {
+        const Label& label = *labels_[round][stop_index];
+        const Line& line = lines_[label.line_index];
+        stop_index = line_stops_[line.offset + label.board_position];
+        route.rides.push_back({line.bus_index, stop_index, label.alight_position - label.board_position,
+                               label.ride_weight, bus_wait_time_});
+    }
+    reverse(route.rides.begin(), route.rides.end());
+    return route;
+}
+
+} // namespace raptor
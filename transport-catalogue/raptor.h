@@ -0,0 +1,101 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace raptor {
+
+// Round-based routing straight over the stop sequences of the buses: round k finds
+// the best routes that take k buses, scanning every bus through a stop improved in
+// round k - 1. Nothing is precomputed beyond the flattened sequences, so memory is
+// linear in the total length of the buses instead of quadratic like the graph's edges.
+class Raptor final : public transport_router::RouteBuilder {
+public:
+    Raptor(const transport::TransportCatalogue& transport_catalogue,
+           const transport_router::RoutingSettings& routing_settings);
+
+    std::optional<transport_router::Route> BuildRoute(size_t from_stop_index, size_t to_stop_index) const override;
+
+    // One search without target pruning serves all the stops.
+    std::vector<std::optional<transport_router::Route>> BuildRoutes(
+        size_t from_stop_index, const std::vector<size_t>& to_stop_indexs) const override;
+
+    // Rounds that drop the labels heavier than max_weight.
+    std::vector<transport_router::StopArrival> FindReachableStops(size_t from_stop_index,
+                                                                  double max_weight) const override;
+
+    // Round k keeps the routes to a stop only where they beat all routes of fewer rides,
+    // so the rounds that reached the stop are its Pareto set.
+    std::vector<transport_router::Route> BuildParetoRoutes(size_t from_stop_index,
+                                                           size_t to_stop_index) const override;
+
+    // Lines of closed buses aren't scanned, and closed stops are neither boarded at nor labelled.
+    void SetClosures(const transport_router::Closures& closures) override;
+
+    std::optional<transport_router::Route> BuildRouteAvoiding(size_t from_stop_index, size_t to_stop_index,
+                                                              double departure_time,
+                                                              const transport_router::Closures& avoid) const override;
+
+private:
+    // One direction of a bus. Non-ring buses get two.
+    struct Line {
+        size_t bus_index;
+        size_t offset;
+        size_t stop_count;
+    };
+
+    struct LinePosition {
+        size_t line_index;
+        size_t position;
+    };
+
+    // A route to a stop improved in some round: its last ride is on the line from
+    // board_position to alight_position, and the boarding stop got its route in the
+    // previous round.
+    struct Label {
+        double weight;
+        size_t line_index;
+        size_t board_position;
+        size_t alight_position;
+        double ride_weight;
+    };
+
+    // distances are the road distances from the first stop of the line, as the bus keeps them.
+    void AddLine(size_t bus_index, std::vector<size_t> stop_indexs, const std::vector<int>& distances);
+
+    void ScanLine(size_t line_index, size_t first_position, size_t round, size_t to_stop_index,
+                  double max_weight) const;
+
+    // Runs the rounds from the stop and returns the last one. Labels heavier than max_weight
+    // or no better than the route to to_stop_index are dropped; the largest size_t keeps them all.
+    size_t Search(size_t from_stop_index, size_t to_stop_index,
+                  double max_weight = std::numeric_limits<double>::infinity()) const;
+
+    std::optional<transport_router::Route> ExtractRoute(size_t to_stop_index, size_t round) const;
+
+    double bus_wait_time_;
+    double bus_velocity_;
+
+    std::vector<Line> lines_;
+    // Stops of all lines one after another; segment_weights_[i] is the ride
+    // from line_stops_[i - 1] to line_stops_[i] within a line.
+    std::vector<size_t> line_stops_;
+    std::vector<double> segment_weights_;
+    // Lines through each stop, in compressed rows.
+    std::vector<size_t> stop_line_offsets_;
+    std::vector<LinePosition> stop_lines_;
+    // Avoided stops and buses join the closures for the time of a query.
+    mutable transport_router::ClosureFlags closures_;
+
+    mutable std::vector<std::vector<std::optional<Label>>> labels_;
+    mutable std::vector<double> best_weights_;
+    mutable std::vector<bool> marked_;
+    mutable std::vector<size_t> marked_stops_;
+    mutable std::vector<size_t> first_line_positions_;
+    mutable std::vector<size_t> scanned_lines_;
+};
+
+} // namespace raptor
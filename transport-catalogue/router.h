@@ -1,117 +1,354 @@
 #pragma once
 
 #include "graph.h"
+#include "min_plus.h"
+#include "thread_pool.h"
+#include <router.pb.h>
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <optional>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace graph {
 
+// Queries are const, but routers may keep scratch buffers between them, so a router must
+// not be shared between threads.
 template <typename Weight>
-class Router {
+class RouterBase {
+public:
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    virtual std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const = 0;
+
+    // The weight of the route, with its edges written over the buffer, so that a buffer kept
+    // between queries spares them allocating. Routers that can build a route in place override it.
+    virtual std::optional<Weight> BuildRouteInto(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+        auto route = BuildRoute(from, to);
+        if (!route) {
+            return std::nullopt;
+        }
+        edges.assign(route->edges.begin(), route->edges.end());
+        return route->weight;
+    }
+
+    // Routes from one vertex to each of the given ones. Routers that search override it
+    // to answer all of them from a single search.
+    virtual std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& to) const {
+        std::vector<std::optional<RouteInfo>> routes;
+        routes.reserve(to.size());
+        for (const VertexId vertex : to) {
+            routes.push_back(BuildRoute(from, vertex));
+        }
+        return routes;
+    }
+
+    virtual proto::RouterData OutProto() const = 0;
+
+    // Vertices settled by all the searches run so far, for routers that search per query.
+    virtual size_t GetSettledVertexCount() const {
+        return 0;
+    }
+
+    // Repairs the precomputed data after the graph gained vertices and edges or some of its
+    // edges got lighter; edges are the added and lightened ones. Routers that can't repair
+    // their data return false and are to be built anew.
+    virtual bool UpdateEdges(const std::vector<EdgeId>& /*edges*/) {
+        return false;
+    }
+
+    virtual ~RouterBase() = default;
+};
+
+template <typename Weight>
+class Router final : public RouterBase<Weight> {
 private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
+    using typename RouterBase<Weight>::RouteInfo;
+
     explicit Router(const Graph& graph);
+    Router(const Graph& graph, const proto::Router& proto_router);
 
-    struct RouteInfo {
-        Weight weight;
-        std::vector<EdgeId> edges;
-    };
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    std::optional<Weight> BuildRouteInto(VertexId from, VertexId to, std::vector<EdgeId>& edges) const override;
+
+    // O(V^2) per edge instead of the O(V^3) of a new table: a route improved by an edge is
+    // the best route into its start, the edge and the best route out of its end, and
+    // neither of those improves through the edge itself.
+    bool UpdateEdges(const std::vector<EdgeId>& edges) override;
 
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    proto::RouterData OutProto() const override;
+    void InProto(const proto::Router& proto_router);
 
 private:
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    // Floyd-Warshall runs over BLOCK_SIZE x BLOCK_SIZE tiles of the matrices, so that a tile
+    // and the two tiles it is relaxed through stay in cache for a whole block of vertices.
+    static constexpr size_t BLOCK_SIZE = 64;
 
     void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            weights_[vertex * vertex_count_ + vertex] = ZERO_WEIGHT;
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                const size_t cell = vertex * vertex_count_ + edge.to;
+                if (edge.weight < weights_[cell]) {
+                    weights_[cell] = edge.weight;
+                    prev_edges_[cell] = edge_id;
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-        }
-    }
+    // Values of routes into and out of the vertices of the current block, taken when the vertex
+    // is used as an intermediate one. Relaxing through them instead of the live cells keeps
+    // the arithmetic identical to the plain vertex-by-vertex Floyd-Warshall.
+    struct BlockRoutes {
+        std::vector<Weight> weights_to_through;       // [vertex_from][vertex_through - begin]
+        std::vector<Weight> weights_from_through;     // [vertex_through - begin][vertex_to]
+        std::vector<EdgeId> prev_edges_from_through;
+    };
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
+    void RelaxTile(BlockRoutes& block_routes, size_t block_from, size_t block_to, size_t block_through) {
+        const VertexId from_begin = block_from * BLOCK_SIZE;
+        const VertexId from_end = std::min(vertex_count_, from_begin + BLOCK_SIZE);
+        const VertexId to_begin = block_to * BLOCK_SIZE;
+        const VertexId to_end = std::min(vertex_count_, to_begin + BLOCK_SIZE);
+        const VertexId through_begin = block_through * BLOCK_SIZE;
+        const VertexId through_end = std::min(vertex_count_, through_begin + BLOCK_SIZE);
+
+        for (VertexId vertex_through = through_begin; vertex_through < through_end; ++vertex_through) {
+            const size_t through = vertex_through - through_begin;
+            Weight* weights_from_through = &block_routes.weights_from_through[through * vertex_count_];
+            EdgeId* prev_edges_from_through = &block_routes.prev_edges_from_through[through * vertex_count_];
+            if (block_from == block_through) {
+                std::copy(&weights_[vertex_through * vertex_count_ + to_begin],
+                          &weights_[vertex_through * vertex_count_ + to_end],
+                          weights_from_through + to_begin);
+                std::copy(&prev_edges_[vertex_through * vertex_count_ + to_begin],
+                          &prev_edges_[vertex_through * vertex_count_ + to_end],
+                          prev_edges_from_through + to_begin);
+            }
+            if (block_to == block_through) {
+                for (VertexId vertex_from = from_begin; vertex_from < from_end; ++vertex_from) {
+                    block_routes.weights_to_through[vertex_from * BLOCK_SIZE + through] =
+                        weights_[vertex_from * vertex_count_ + vertex_through];
+                }
+            }
+
+            for (VertexId vertex_from = from_begin; vertex_from < from_end; ++vertex_from) {
+                const Weight weight_from = block_routes.weights_to_through[vertex_from * BLOCK_SIZE + through];
+                if (weight_from == INFINITE_WEIGHT) {
+                    continue;
                 }
+                min_plus::RelaxRow(weight_from,
+                                   weights_from_through + to_begin, prev_edges_from_through + to_begin,
+                                   &weights_[vertex_from * vertex_count_ + to_begin],
+                                   &prev_edges_[vertex_from * vertex_count_ + to_begin],
+                                   to_end - to_begin);
             }
         }
     }
 
+    // The diagonal tile goes first, then the rest of its row and column, then all other tiles.
+    // Within one phase every tile reads only what earlier phases wrote, so the tiles of a phase
+    // are relaxed in parallel.
+    void RelaxRoutesInternalDataThroughBlock(thread_pool::ThreadPool& pool, BlockRoutes& block_routes,
+                                             size_t block_count, size_t block_through) {
+        RelaxTile(block_routes, block_through, block_through, block_through);
+        if (block_count == 1) {
+            return;
+        }
+
+        pool.ParallelFor(2 * (block_count - 1), [this, &block_routes, block_count, block_through](size_t i) {
+            size_t block = i % (block_count - 1);
+            block += block >= block_through;
+            if (i < block_count - 1) {
+                RelaxTile(block_routes, block_through, block, block_through);
+            } else {
+                RelaxTile(block_routes, block, block_through, block_through);
+            }
+        });
+
+        pool.ParallelFor((block_count - 1) * (block_count - 1), [this, &block_routes, block_count, block_through](size_t i) {
+            size_t block_from = i / (block_count - 1);
+            size_t block_to = i % (block_count - 1);
+            block_from += block_from >= block_through;
+            block_to += block_to >= block_through;
+            RelaxTile(block_routes, block_from, block_to, block_through);
+        });
+    }
+
     static constexpr Weight ZERO_WEIGHT{};
+    // Without a real infinity half of the range is left free, so that a route plus
+    // a missing route can't overflow.
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::has_infinity
+                                              ? std::numeric_limits<Weight>::infinity()
+                                              : std::numeric_limits<Weight>::max() / 2;
+    static constexpr EdgeId NONE_EDGE = std::numeric_limits<EdgeId>::max();
+
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    size_t vertex_count_;
+    std::vector<Weight> weights_;
+    std::vector<EdgeId> prev_edges_;
 };
 
 template <typename Weight>
 Router<Weight>::Router(const Graph& graph)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , vertex_count_(graph.GetVertexCount())
+    , weights_(vertex_count_ * vertex_count_, INFINITE_WEIGHT)
+    , prev_edges_(vertex_count_ * vertex_count_, NONE_EDGE)
 {
     InitializeRoutesInternalData(graph);
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    const size_t block_count = (vertex_count_ + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    BlockRoutes block_routes{
+        std::vector<Weight>(vertex_count_ * BLOCK_SIZE),
+        std::vector<Weight>(BLOCK_SIZE * vertex_count_),
+        std::vector<EdgeId>(BLOCK_SIZE * vertex_count_)
+    };
+    thread_pool::ThreadPool pool(block_count > 1 ? std::thread::hardware_concurrency() : 1);
+    for (size_t block_through = 0; block_through < block_count; ++block_through) {
+        RelaxRoutesInternalDataThroughBlock(pool, block_routes, block_count, block_through);
     }
 }
 
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, const proto::Router& proto_router)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+{
+    InProto(proto_router);
+}
+
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+    std::vector<EdgeId> edges;
+    const auto weight = BuildRouteInto(from, to, edges);
+    if (!weight) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    return RouteInfo{*weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::optional<Weight> Router<Weight>::BuildRouteInto(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+    const Weight weight = weights_[from * vertex_count_ + to];
+    if (weight == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+    // The prev edges of a route all lie in the row of its start, so the walk back never
+    // leaves one row of the table.
+    const EdgeId* prev_edges_from = &prev_edges_[from * vertex_count_];
+    edges.clear();
+    for (EdgeId edge_id = prev_edges_from[to];
+         edge_id != NONE_EDGE;
+         edge_id = prev_edges_from[graph_.GetEdge(edge_id).from])
     {
-        edges.push_back(*edge_id);
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
+    return weight;
+}
 
-    return RouteInfo{weight, std::move(edges)};
+template <typename Weight>
+bool Router<Weight>::UpdateEdges(const std::vector<EdgeId>& edges) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (vertex_count != vertex_count_) {
+        // New vertices start unreachable from everywhere but themselves.
+        std::vector<Weight> weights(vertex_count * vertex_count, INFINITE_WEIGHT);
+        std::vector<EdgeId> prev_edges(vertex_count * vertex_count, NONE_EDGE);
+        for (VertexId from = 0; from < vertex_count_; ++from) {
+            std::copy(&weights_[from * vertex_count_], &weights_[(from + 1) * vertex_count_],
+                      &weights[from * vertex_count]);
+            std::copy(&prev_edges_[from * vertex_count_], &prev_edges_[(from + 1) * vertex_count_],
+                      &prev_edges[from * vertex_count]);
+        }
+        for (VertexId vertex = vertex_count_; vertex < vertex_count; ++vertex) {
+            weights[vertex * vertex_count + vertex] = ZERO_WEIGHT;
+        }
+        weights_ = std::move(weights);
+        prev_edges_ = std::move(prev_edges);
+        vertex_count_ = vertex_count;
+    }
+
+    std::vector<Weight> weights_from_edge(vertex_count_);
+    std::vector<EdgeId> prev_edges_from_edge(vertex_count_);
+    for (const EdgeId edge_id : edges) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        const size_t edge_to_row = edge.to * vertex_count_;
+        std::copy(&weights_[edge_to_row], &weights_[edge_to_row + vertex_count_], weights_from_edge.begin());
+        std::copy(&prev_edges_[edge_to_row], &prev_edges_[edge_to_row + vertex_count_], prev_edges_from_edge.begin());
+        prev_edges_from_edge[edge.to] = edge_id;
+
+        for (VertexId from = 0; from < vertex_count_; ++from) {
+            const Weight weight_to_edge = weights_[from * vertex_count_ + edge.from];
+            if (weight_to_edge == INFINITE_WEIGHT) {
+                continue;
+            }
+            min_plus::RelaxRow(weight_to_edge + edge.weight, weights_from_edge.data(), prev_edges_from_edge.data(),
+                               &weights_[from * vertex_count_], &prev_edges_[from * vertex_count_], vertex_count_);
+        }
+    }
+    return true;
+}
+
+template <typename Weight>
+proto::RouterData Router<Weight>::OutProto() const {
+    proto::RouterData proto_router_data;
+    proto::Router& proto_router = *proto_router_data.mutable_router();
+
+    proto_router.mutable_weight()->Reserve(weights_.size());
+    for (const Weight weight : weights_) {
+        proto_router.add_weight(weight != INFINITE_WEIGHT ? weight : std::numeric_limits<double>::infinity());
+    }
+    proto_router.mutable_prev_edge()->Reserve(prev_edges_.size());
+    for (const EdgeId prev_edge : prev_edges_) {
+        proto_router.add_prev_edge(prev_edge != NONE_EDGE ? prev_edge + 1 : 0);
+    }
+
+    return proto_router_data;
+}
+
+template <typename Weight>
+void Router<Weight>::InProto(const proto::Router& proto_router) {
+    if (proto_router.weight_size() != vertex_count_ * vertex_count_
+        || proto_router.prev_edge_size() != vertex_count_ * vertex_count_) {
+        throw std::invalid_argument("Routes table doesn't match the graph");
+    }
+
+    weights_.resize(proto_router.weight_size());
+    for (size_t i = 0; i < weights_.size(); ++i) {
+        const double weight = proto_router.weight(i);
+        weights_[i] = weight != std::numeric_limits<double>::infinity() ? static_cast<Weight>(weight) : INFINITE_WEIGHT;
+    }
+    prev_edges_.resize(proto_router.prev_edge_size());
+    for (size_t i = 0; i < prev_edges_.size(); ++i) {
+        const uint64_t prev_edge = proto_router.prev_edge(i);
+        prev_edges_[i] = prev_edge ? prev_edge - 1 : NONE_EDGE;
+    }
 }
 
 }  // namespace graph
\ No newline at end of file
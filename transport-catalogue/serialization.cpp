@@ -1,5 +1,9 @@
 #include "serialization.h"
+#include "log_duration.h"
+#include "thread_pool.h"
 #include <transport_catalogue.pb.h>
+#include <functional>
+#include <stdexcept>
 #include <utility>
 #include <string>
 #include <string_view>
@@ -9,22 +13,45 @@ using namespace std;
 namespace serialization {
 
 void Serialize(const transport::TransportCatalogue& transport_catalogue, const map_renderer::VectorDrawables& drawables,
-               const graph::DirectedWeightedGraph<double>& transport_graph, const transport_router::TransportRoutes& transport_routes, ostream& output) {
-    proto::Data proto_data;
+               const graph::DirectedWeightedGraph<double>& transport_graph, const transport_router::TransportRoutes& transport_routes,
+               proto::RouterData router_data, ostream& output) {
+    // Each part reads only its own object, so they are built at the same time and moved
+    // into the message after, which must not be changed from several threads.
+    proto::TransportCatalogue proto_transport_catalogue;
+    proto::Drawables proto_drawables;
+    proto::DirectedWeightedGraph proto_transport_graph;
+    proto::TransportRoutes proto_transport_routes;
+    {
+        log_duration::LogDuration duration("protos"sv);
+        const vector<function<void()>> parts = {
+            [&]() { proto_transport_catalogue = transport_catalogue.OutProto(); },
+            [&]() { proto_drawables = drawables.OutProto(); },
+            [&]() { proto_transport_graph = transport_graph.OutProto(); },
+            [&]() { proto_transport_routes = transport_routes.OutProto(); }
+        };
+        thread_pool::ThreadPool pool(parts.size());
+        pool.ParallelFor(parts.size(), [&parts](size_t part) { parts[part](); });
+    }
 
-    *proto_data.mutable_transport_catalogue() = transport_catalogue.OutProto();
-    *proto_data.mutable_drawables() = drawables.OutProto();
-    *proto_data.mutable_transport_graph() = transport_graph.OutProto();
-    *proto_data.mutable_transport_routes() = transport_routes.OutProto();
+    proto::Data proto_data;
+    *proto_data.mutable_transport_catalogue() = move(proto_transport_catalogue);
+    *proto_data.mutable_drawables() = move(proto_drawables);
+    *proto_data.mutable_transport_graph() = move(proto_transport_graph);
+    *proto_data.mutable_transport_routes() = move(proto_transport_routes);
+    // The router's tables may be most of the base, so they are moved in rather than copied.
+    *proto_data.mutable_router_data() = move(router_data);
 
+    log_duration::LogDuration duration("writing"sv);
     proto_data.SerializeToOstream(&output);
 }
 
 tuple<transport::TransportCatalogue, vector<unique_ptr<svg::Drawable>>,
-    graph::DirectedWeightedGraph<double>, transport_router::TransportRoutes> Deserialize(istream& input)
+    graph::DirectedWeightedGraph<double>, transport_router::TransportRoutes, proto::RouterData> Deserialize(istream& input)
 {
     proto::Data proto_data;
-    proto_data.ParseFromIstream(&input);
+    if (!proto_data.ParseFromIstream(&input)) {
+        throw invalid_argument("Base can't be read");
+    }
 
     transport::TransportCatalogue transport_catalogue;
     transport_catalogue.InProto(proto_data.transport_catalogue());
@@ -38,7 +65,8 @@ tuple<transport::TransportCatalogue, vector<unique_ptr<svg::Drawable>>,
     transport_router::TransportRoutes transport_routes;
     transport_routes.InProto(proto_data.transport_routes());
 
-    return { move(transport_catalogue), move(drawables.drawables), move(transport_graph), move(transport_routes) };
+    return { move(transport_catalogue), move(drawables.drawables), move(transport_graph), move(transport_routes),
+             move(*proto_data.mutable_router_data()) };
 }
 
 } // namespace serilization
\ No newline at end of file
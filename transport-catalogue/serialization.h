@@ -4,6 +4,7 @@
 #include "map_renderer.h"
 #include "svg.h"
 #include "graph.h"
+#include "router.h"
 #include "transport_router.h"
 #include <tuple>
 #include <iostream>
@@ -13,9 +14,12 @@
 namespace serialization {
 
 void Serialize(const transport::TransportCatalogue& transport_catalogue, const map_renderer::VectorDrawables& drawables,
-			const graph::DirectedWeightedGraph<double>& transport_graph, const transport_router::TransportRoutes& transport_routes, std::ostream& output);
+			const graph::DirectedWeightedGraph<double>& transport_graph, const transport_router::TransportRoutes& transport_routes,
+			proto::RouterData router_data, std::ostream& output);
 
+// The router keeps a reference to the graph, so only its precomputed data is returned;
+// pass it to transport_router::CreateRouter once the graph has its final address.
 std::tuple<transport::TransportCatalogue, std::vector<std::unique_ptr<svg::Drawable>>,
-	graph::DirectedWeightedGraph<double>, transport_router::TransportRoutes> Deserialize(std::istream& input);
+	graph::DirectedWeightedGraph<double>, transport_router::TransportRoutes, proto::RouterData> Deserialize(std::istream& input);
 
 } // namespace serilization
\ No newline at end of file
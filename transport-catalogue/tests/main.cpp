@@ -0,0 +1,28 @@
+#include <iostream>
+#include <string_view>
+#include <utility>
+#include "tests.h"
+
+using namespace std::literals;
+
+int main() {
+    const std::pair<std::string_view, void (*)()> tests[] = {
+        {"TestAlternativeRoutes"sv, tests::TestAlternativeRoutes},
+        {"TestCreateStopsAndBuses"sv, tests::TestCreateStopsAndBuses},
+        {"TestMoveCatalogue"sv, tests::TestMoveCatalogue},
+        {"TestParallelForException"sv, tests::TestParallelForException},
+        {"TestReachableStops"sv, tests::TestReachableStops},
+        {"TestUpdateBase"sv, tests::TestUpdateBase},
+    };
+    int failed_count = 0;
+    for (const auto& [name, test] : tests) {
+        try {
+            test();
+            std::cerr << name << " OK\n"sv;
+        } catch (const std::exception& e) {
+            ++failed_count;
+            std::cerr << name << " failed: "sv << e.what() << '\n';
+        }
+    }
+    return failed_count == 0 ? 0 : 1;
+}
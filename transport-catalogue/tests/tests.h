@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+// Fails the running test with the place and text of the condition when it doesn't hold.
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) \
+                                     + ": " + #condition);                                   \
+        }                                                                                    \
+    } while (false)
+
+namespace tests {
+
+void TestAlternativeRoutes();
+void TestCreateStopsAndBuses();
+void TestMoveCatalogue();
+void TestParallelForException();
+void TestReachableStops();
+void TestUpdateBase();
+
+} // namespace tests
@@ -0,0 +1,33 @@
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include "../thread_pool.h"
+#include "tests.h"
+
+using namespace std;
+
+namespace tests {
+
+void TestParallelForException() {
+    thread_pool::ThreadPool pool(4);
+    atomic<size_t> call_count = 0;
+    string message;
+    try {
+        pool.ParallelFor(1000, [&call_count](size_t i) {
+            ++call_count;
+            if (i == 10) {
+                throw runtime_error("task 10");
+            }
+        });
+    } catch (const runtime_error& e) {
+        message = e.what();
+    }
+    CHECK(message == "task 10");
+
+    // The pool runs the next calls as usual.
+    call_count = 0;
+    pool.ParallelFor(1000, [&call_count](size_t) { ++call_count; });
+    CHECK(call_count == 1000);
+}
+
+} // namespace tests
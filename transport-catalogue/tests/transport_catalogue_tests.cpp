@@ -0,0 +1,69 @@
+#include <sstream>
+#include <string>
+#include <utility>
+#include "../json_reader.h"
+#include "../transport_catalogue.h"
+#include "tests.h"
+
+using namespace std;
+
+namespace tests {
+
+namespace {
+
+// One-letter names all fit into a short string, whose characters move with it.
+void CheckStops(const transport::TransportCatalogue& transport_catalogue) {
+    const string names[] = {"A", "B", "C", "D"};
+    CHECK(transport_catalogue.GetStopCount() == 4);
+    for (size_t i = 0; i < 4; ++i) {
+        CHECK(transport_catalogue.IndexStop(names[i]) == i);
+        const auto stop = transport_catalogue.FindStop(names[i]);
+        CHECK(stop && stop->name == names[i]);
+        CHECK(stop->coordinates.lat == 55.0 + i);
+    }
+    CHECK(!transport_catalogue.FindStop("E"));
+    CHECK(transport_catalogue.FindBus("1") != nullptr);
+    CHECK(transport_catalogue.GetRoadDistance(0, 1) == 100);
+}
+
+} // namespace
+
+void TestMoveCatalogue() {
+    transport::TransportCatalogue transport_catalogue;
+    for (const string name : {"A", "B", "C", "D"}) {
+        transport_catalogue.AddStop(name, {55.0 + transport_catalogue.GetStopCount(), 37.0});
+    }
+    transport_catalogue.SetDistanceBetweenStops("A", "B", 100);
+    transport_catalogue.SetDistanceBetweenStops("C", "B", 100);
+    transport_catalogue.SetDistanceBetweenStops("D", "C", 100);
+    transport_catalogue.AddBus("1", {"A", "B", "C", "D"}, false);
+    transport_catalogue.Finalize();
+    CheckStops(transport_catalogue);
+
+    transport::TransportCatalogue moved_catalogue(move(transport_catalogue));
+    CheckStops(moved_catalogue);
+
+    transport::TransportCatalogue assigned_catalogue;
+    assigned_catalogue.AddStop("X", {0, 0});
+    assigned_catalogue = move(moved_catalogue);
+    CheckStops(assigned_catalogue);
+}
+
+void TestCreateStopsAndBuses() {
+    istringstream input(R"([
+        {"type": "Stop", "name": "A", "latitude": 55.0, "longitude": 37.0, "road_distances": {"B": 100}},
+        {"type": "Stop", "name": "B", "latitude": 56.0, "longitude": 37.0, "road_distances": {}},
+        {"type": "Stop", "name": "C", "latitude": 57.0, "longitude": 37.0, "road_distances": {"B": 100}},
+        {"type": "Stop", "name": "D", "latitude": 58.0, "longitude": 37.0, "road_distances": {"C": 100}},
+        {"type": "Bus", "name": "1", "stops": ["A", "B", "C", "D"], "is_roundtrip": false}
+    ])");
+    const auto base_requests = json::Load(input);
+    const auto [transport_catalogue, stops, buses] =
+        transport::json_reader::CreateStopsAndBuses(base_requests.GetRoot().AsArray());
+    CheckStops(transport_catalogue);
+    CHECK(stops.size() == 4);
+    CHECK(stops.at("C").lat == 57.0);
+    CHECK(buses.size() == 1);
+}
+
+} // namespace tests
@@ -0,0 +1,230 @@
+#include <cmath>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../json_reader.h"
+#include "tests.h"
+
+using namespace std;
+
+namespace tests {
+
+namespace {
+
+// Bus 1 goes from Airport over Bridge and Cathedral to Docks and bus 2 over East gate, both
+// there and back; the ring bus 3 goes Park, Quay, Railway station and back to Park. Bus 4
+// goes from Exhibition over Yacht club to Zoo, and bus 5 from Exhibition to Yacht club.
+const string BASE_REQUESTS = R"([
+    {"type": "Stop", "name": "Airport", "latitude": 55.60, "longitude": 37.60, "road_distances": {"Bridge": 1000, "East gate": 2000}},
+    {"type": "Stop", "name": "Bridge", "latitude": 55.61, "longitude": 37.60, "road_distances": {"Cathedral": 1000}},
+    {"type": "Stop", "name": "Cathedral", "latitude": 55.62, "longitude": 37.60, "road_distances": {"Docks": 1000}},
+    {"type": "Stop", "name": "Docks", "latitude": 55.63, "longitude": 37.60, "road_distances": {"East gate": 2000}},
+    {"type": "Stop", "name": "East gate", "latitude": 55.61, "longitude": 37.62, "road_distances": {}},
+    {"type": "Stop", "name": "Park", "latitude": 55.70, "longitude": 37.70, "road_distances": {"Quay": 1000}},
+    {"type": "Stop", "name": "Quay", "latitude": 55.71, "longitude": 37.70, "road_distances": {"Railway station": 1000}},
+    {"type": "Stop", "name": "Railway station", "latitude": 55.71, "longitude": 37.71, "road_distances": {"Park": 1000}},
+    {"type": "Stop", "name": "Exhibition", "latitude": 55.80, "longitude": 37.80, "road_distances": {"Yacht club": 1000}},
+    {"type": "Stop", "name": "Yacht club", "latitude": 55.81, "longitude": 37.80, "road_distances": {"Zoo": 1000}},
+    {"type": "Stop", "name": "Zoo", "latitude": 55.82, "longitude": 37.80, "road_distances": {}},
+    {"type": "Bus", "name": "1", "stops": ["Airport", "Bridge", "Cathedral", "Docks"], "is_roundtrip": false},
+    {"type": "Bus", "name": "2", "stops": ["Airport", "East gate", "Docks"], "is_roundtrip": false},
+    {"type": "Bus", "name": "3", "stops": ["Park", "Quay", "Railway station", "Park"], "is_roundtrip": true},
+    {"type": "Bus", "name": "4", "stops": ["Exhibition", "Yacht club", "Zoo"], "is_roundtrip": false},
+    {"type": "Bus", "name": "5", "stops": ["Exhibition", "Yacht club"], "is_roundtrip": false}
+])";
+
+const string RENDER_SETTINGS = R"({
+    "width": 600, "height": 400, "padding": 50, "line_width": 14, "stop_radius": 5,
+    "bus_label_font_size": 20, "bus_label_offset": [7, 15],
+    "stop_label_font_size": 18, "stop_label_offset": [7, -3],
+    "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+    "color_palette": ["green", "red"]
+})";
+
+json::Document LoadJson(const string& text) {
+    istringstream input(text);
+    return json::Load(input);
+}
+
+// The buses and stops the rides take, which tell routes apart.
+vector<pair<size_t, size_t>> GetRides(const transport_router::Route& route) {
+    vector<pair<size_t, size_t>> rides;
+    for (const auto& ride : route.rides) {
+        rides.emplace_back(ride.bus_index, ride.stop_index);
+    }
+    return rides;
+}
+
+// A base built from the requests, with its router and route builder, which refer to it
+// and so keep it in place.
+struct Base {
+    transport::TransportCatalogue transport_catalogue;
+    graph::DirectedWeightedGraph<double> transport_graph;
+    transport_router::TransportRoutes transport_routes;
+    unique_ptr<graph::RouterBase<double>> router;
+    unique_ptr<transport_router::RouteBuilder> route_builder;
+};
+
+unique_ptr<Base> CreateBase(const json::Array& base_requests, const string& routing_settings) {
+    auto base = make_unique<Base>();
+    auto [transport_catalogue, picture, transport_graph, transport_routes] =
+        transport::json_reader::CreateTransportCatalogue(
+            base_requests,
+            transport::json_reader::CreateRenderSettings(LoadJson(RENDER_SETTINGS).GetRoot().AsDict()),
+            transport::json_reader::CreateRoutingSettings(LoadJson(routing_settings).GetRoot().AsDict()));
+    base->transport_catalogue = move(transport_catalogue);
+    base->transport_graph = move(transport_graph);
+    base->transport_routes = move(transport_routes);
+    base->router = transport_router::CreateRouter(
+        base->transport_graph,
+        base->transport_routes.GetRoutingSettings(),
+        transport::json_reader::CreateVertexCoordinates(base->transport_catalogue, base->transport_routes,
+                                                        base->transport_graph.GetVertexCount()));
+    base->route_builder = transport::json_reader::CreateRouteBuilder(
+        base->transport_catalogue, base->transport_graph, base->transport_routes, base->router.get(),
+        proto::RouterData());
+    return base;
+}
+
+string MakeRoutingSettings(const string& router_type, const string& graph_model) {
+    return R"({"bus_wait_time": 2, "bus_velocity": 30, "router_type": ")" + router_type
+        + R"(", "graph_model": ")" + graph_model + R"("})";
+}
+
+void TestAlternativeRoutes(const string& graph_model) {
+    const auto base_requests = LoadJson(BASE_REQUESTS);
+    const auto base = CreateBase(base_requests.GetRoot().AsArray(), MakeRoutingSettings("dijkstra", graph_model));
+    const auto& transport_catalogue = base->transport_catalogue;
+    const auto& route_builder = base->route_builder;
+
+    // Getting off bus 1 at Bridge or Cathedral to get back on only adds a wait, so bus 2 is the one
+    // alternative.
+    const auto routes = route_builder->BuildAlternativeRoutes(
+        transport_catalogue.IndexStop("Airport"), transport_catalogue.IndexStop("Docks"), 5);
+    CHECK(routes.size() == 2);
+    set<vector<pair<size_t, size_t>>> known_rides;
+    for (const auto& route : routes) {
+        CHECK(route.rides.size() == 1);
+        CHECK(known_rides.insert(GetRides(route)).second);
+    }
+    CHECK(routes[0].rides[0].bus_index == transport_catalogue.IndexBus("1"));
+    CHECK(routes[1].rides[0].bus_index == transport_catalogue.IndexBus("2"));
+
+    // From Railway station to Quay the ring bus goes over its end, which takes two rides on it.
+    const auto ring_routes = route_builder->BuildAlternativeRoutes(
+        transport_catalogue.IndexStop("Railway station"), transport_catalogue.IndexStop("Quay"), 5);
+    CHECK(ring_routes.size() == 1);
+    CHECK(ring_routes[0].rides.size() == 2);
+
+    // Bus 4 can't be got off and on again at Yacht club, but it can be changed to there
+    // from bus 5.
+    const auto transfer_routes = route_builder->BuildAlternativeRoutes(
+        transport_catalogue.IndexStop("Exhibition"), transport_catalogue.IndexStop("Zoo"), 5);
+    CHECK(transfer_routes.size() == 2);
+    CHECK(transfer_routes[0].rides.size() == 1);
+    CHECK(transfer_routes[0].rides[0].bus_index == transport_catalogue.IndexBus("4"));
+    CHECK(transfer_routes[1].rides.size() == 2);
+    CHECK(transfer_routes[1].rides[0].bus_index == transport_catalogue.IndexBus("5"));
+    CHECK(transfer_routes[1].rides[1].bus_index == transport_catalogue.IndexBus("4"));
+    CHECK(transfer_routes[1].weight == 8);
+}
+
+void TestReachableStops(const string& graph_model) {
+    const auto base_requests = LoadJson(BASE_REQUESTS);
+    const auto base = CreateBase(base_requests.GetRoot().AsArray(), MakeRoutingSettings("dijkstra", graph_model));
+    const auto& transport_catalogue = base->transport_catalogue;
+
+    // The budget is far past any route, so the search ends with the stops it reaches.
+    const auto arrivals = base->route_builder->FindReachableStops(transport_catalogue.IndexStop("Bridge"), 1e10);
+    set<size_t> stop_indexs;
+    for (const auto& arrival : arrivals) {
+        stop_indexs.insert(arrival.stop_index);
+    }
+    CHECK(stop_indexs.size() == 5);
+    CHECK(stop_indexs.count(transport_catalogue.IndexStop("East gate")));
+    CHECK(!stop_indexs.count(transport_catalogue.IndexStop("Park")));
+
+    const auto near_arrivals = base->route_builder->FindReachableStops(transport_catalogue.IndexStop("Bridge"), 5);
+    CHECK(near_arrivals.size() == 3);
+}
+
+// Bridge gets nearer to Cathedral, and the new bus 6 goes from East gate over the new stop
+// Fountain to Cathedral.
+const string UPDATE_REQUESTS = R"([
+    {"type": "Stop", "name": "Bridge", "latitude": 55.61, "longitude": 37.60, "road_distances": {"Cathedral": 500}},
+    {"type": "Stop", "name": "Fountain", "latitude": 55.62, "longitude": 37.62, "road_distances": {"East gate": 800, "Cathedral": 600}},
+    {"type": "Bus", "name": "6", "stops": ["East gate", "Fountain", "Cathedral"], "is_roundtrip": false}
+])";
+
+// The base requests with the update in them.
+string MakeUpdatedBaseRequests() {
+    string base_requests = BASE_REQUESTS;
+    const string distance = R"("road_distances": {"Cathedral": 1000})";
+    base_requests.replace(base_requests.find(distance), distance.size(), R"("road_distances": {"Cathedral": 500})");
+    const string update_requests = UPDATE_REQUESTS;
+    const size_t first_new_request = update_requests.find(R"({"type": "Stop", "name": "Fountain")");
+    base_requests.insert(base_requests.rfind(']'),
+                         ",\n    " + update_requests.substr(first_new_request, update_requests.rfind(']') - first_new_request));
+    return base_requests;
+}
+
+void TestUpdateBase(const string& router_type, const string& graph_model) {
+    const auto base_requests = LoadJson(BASE_REQUESTS);
+    const auto base = CreateBase(base_requests.GetRoot().AsArray(), MakeRoutingSettings(router_type, graph_model));
+    const auto update_requests = LoadJson(UPDATE_REQUESTS);
+    const auto update = transport::json_reader::UpdateTransportCatalogue(
+        update_requests.GetRoot().AsArray(), base->transport_catalogue, base->transport_graph, base->transport_routes);
+    // A shorter distance and new stops and buses only lighten the graph, so the table is repaired.
+    CHECK(!update.has_heavier_edges);
+    CHECK(base->router->UpdateEdges(update.lighter_edges));
+    const auto route_builder = transport::json_reader::CreateRouteBuilder(
+        base->transport_catalogue, base->transport_graph, base->transport_routes, base->router.get(),
+        proto::RouterData());
+
+    const auto updated_base_requests = LoadJson(MakeUpdatedBaseRequests());
+    const auto updated_base =
+        CreateBase(updated_base_requests.GetRoot().AsArray(), MakeRoutingSettings(router_type, graph_model));
+    const auto& transport_catalogue = base->transport_catalogue;
+    const auto& updated_catalogue = updated_base->transport_catalogue;
+    CHECK(transport_catalogue.GetStopCount() == updated_catalogue.GetStopCount());
+    CHECK(transport_catalogue.GetBusCount() == updated_catalogue.GetBusCount());
+    for (size_t from = 0; from < transport_catalogue.GetStopCount(); ++from) {
+        for (size_t to = 0; to < transport_catalogue.GetStopCount(); ++to) {
+            const auto route = route_builder->BuildRoute(from, to);
+            const auto updated_route = updated_base->route_builder->BuildRoute(
+                updated_catalogue.IndexStop(transport_catalogue.FindStop(from).name),
+                updated_catalogue.IndexStop(transport_catalogue.FindStop(to).name));
+            CHECK(route.has_value() == updated_route.has_value());
+            CHECK(!route || abs(route->weight - updated_route->weight) < 1e-6);
+        }
+    }
+    // Fountain is on the way from East gate to Cathedral now, a minute sooner than bus 2 and 1.
+    const auto route = route_builder->BuildRoute(transport_catalogue.IndexStop("East gate"),
+                                                 transport_catalogue.IndexStop("Cathedral"));
+    CHECK(route && route->rides.size() == 1);
+    CHECK(route->rides[0].bus_index == transport_catalogue.IndexBus("6"));
+}
+
+} // namespace
+
+void TestAlternativeRoutes() {
+    TestAlternativeRoutes("stop_pairs");
+    TestAlternativeRoutes("line");
+}
+
+void TestReachableStops() {
+    TestReachableStops("stop_pairs");
+    TestReachableStops("line");
+}
+
+void TestUpdateBase() {
+    for (const string graph_model : {"stop_pairs", "line"}) {
+        TestUpdateBase("floyd", graph_model);
+        TestUpdateBase("floyd_fixed_point", graph_model);
+    }
+}
+
+} // namespace tests
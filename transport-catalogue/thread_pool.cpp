@@ -0,0 +1,94 @@
+#include "thread_pool.h"
+#include <utility>
+
+using namespace std;
+
+namespace thread_pool {
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    for (size_t i = 1; i < thread_count; ++i) {
+        workers_.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    task_ready_.notify_all();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return workers_.size() + 1;
+}
+
+void ThreadPool::ParallelFor(size_t count, const function<void(size_t)>& func) {
+    if (workers_.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    {
+        lock_guard lock(mutex_);
+        func_ = &func;
+        count_ = count;
+        next_index_ = 0;
+        busy_workers_ = workers_.size();
+        ++generation_;
+    }
+    task_ready_.notify_all();
+
+    RunTasks();
+
+    unique_lock lock(mutex_);
+    task_done_.wait(lock, [this]() { return busy_workers_ == 0; });
+    func_ = nullptr;
+    if (exception_) {
+        rethrow_exception(exchange(exception_, nullptr));
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    size_t seen_generation = 0;
+    while (true) {
+        {
+            unique_lock lock(mutex_);
+            task_ready_.wait(lock, [this, seen_generation]() {
+                return stopping_ || generation_ != seen_generation;
+            });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+        }
+
+        RunTasks();
+
+        lock_guard lock(mutex_);
+        if (--busy_workers_ == 0) {
+            task_done_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunTasks() {
+    try {
+        for (size_t i = next_index_++; i < count_; i = next_index_++) {
+            (*func_)(i);
+        }
+    } catch (...) {
+        next_index_ = count_;
+        lock_guard lock(mutex_);
+        if (!exception_) {
+            exception_ = current_exception();
+        }
+    }
+}
+
+} // namespace thread_pool
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace thread_pool {
+
+class ThreadPool final {
+public:
+    // thread_count counts the calling thread too, so 1 means "run inline".
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    size_t GetThreadCount() const;
+
+    // Calls func(i) for every i in [0, count) and returns when all calls are done. If a call
+    // throws, the calls not yet started are skipped and the first exception is rethrown here.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+private:
+    void WorkerLoop();
+    void RunTasks();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable task_ready_;
+    std::condition_variable task_done_;
+
+    const std::function<void(size_t)>* func_ = nullptr;
+    size_t count_ = 0;
+    std::atomic<size_t> next_index_ = 0;
+    size_t busy_workers_ = 0;
+    size_t generation_ = 0;
+    bool stopping_ = false;
+    // The first exception of the running ParallelFor.
+    std::exception_ptr exception_;
+};
+
+} // namespace thread_pool
@@ -1,5 +1,9 @@
 #include "transport_catalogue.h"
 #include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
 #include <unordered_set>
 
 using namespace std;
@@ -17,44 +21,11 @@ const Bus& TransportCatalogue::AddBus(string name, vector<string_view> names_sto
     vector<size_t>& stop_indexs = bus.stop_indexs;
     stop_indexs.reserve(names_stops.size());
     for (const string_view name_stop : names_stops) {
-        const size_t stop_index = stop_index_by_name_.at(name_stop);
-        vector<size_t>& bus_indexs = stops_[stop_index].bus_indexs;
-
-        if (bus_indexs.empty()) {
-            bus_indexs.push_back(bus_index);
-        } else {
-            auto it = lower_bound(bus_indexs.begin(), bus_indexs.end(), bus_index,
-                [this](size_t lhs, size_t rhs) { return buses_[lhs].name < buses_[rhs].name; });
-            if (it == bus_indexs.end() || *it != bus_index) {
-                bus_indexs.insert(it, bus_index);
-            }
-        }
-
-        stop_indexs.push_back(stop_index);
-    }
-
-    if (ring) {
-        for (size_t i = 0; i < stop_indexs.size() - 1; ++i) {
-            auto it = stops_[stop_indexs[i]].distance_to_stops.find(stop_indexs[i + 1]);
-            it = it != stops_[stop_indexs[i]].distance_to_stops.end() ?
-                 it : stops_[stop_indexs[i + 1]].distance_to_stops.find(stop_indexs[i]);
-            bus.length += it->second;
-            bus.ideal_length += geo::ComputeDistance(stops_[stop_indexs[i]].coordinates,
-                                                 stops_[stop_indexs[i + 1]].coordinates);
-        }
-    } else {
-        for (size_t i = 0; i < stop_indexs.size() - 1; ++i) {
-            auto it1 = stops_[stop_indexs[i]].distance_to_stops.find(stop_indexs[i + 1]);
-            auto it2 = stops_[stop_indexs[i + 1]].distance_to_stops.find(stop_indexs[i]);
-            bus.length += it1 != stops_[stop_indexs[i]].distance_to_stops.end() &&
-                      it2 != stops_[stop_indexs[i + 1]].distance_to_stops.end() ?
-                          it1->second + it2->second :
-                            it1 != stops_[stop_indexs[i]].distance_to_stops.end() ?
-                                2 * it1->second : 2 * it2->second;
-            bus.ideal_length += 2 * geo::ComputeDistance(stops_[stop_indexs[i]].coordinates,
-                                                     stops_[stop_indexs[i + 1]].coordinates);
-        }
+        stop_indexs.push_back(stop_index_by_name_.at(name_stop));
     }
+    // The buses of the stops are packed again by Finalize.
+    stop_bus_offsets_.clear();
+    stop_bus_indexs_.clear();
 
     bus.count_stops = ring ? stop_indexs.size() : 2 * stop_indexs.size() - 1;
     bus.count_unique_stops = [stop_indexs]() {
@@ -64,11 +35,75 @@ const Bus& TransportCatalogue::AddBus(string name, vector<string_view> names_sto
 
     return bus;
 }
+
+void TransportCatalogue::ComputeBusDistances(Bus& bus) const {
+    const vector<size_t>& stop_indexs = bus.stop_indexs;
+    bus.forward_distances.assign(stop_indexs.size(), 0);
+    bus.backward_distances.assign(bus.ring ? 0 : stop_indexs.size(), 0);
+    bus.ideal_length = 0;
+    for (size_t i = 1; i < stop_indexs.size(); ++i) {
+        bus.forward_distances[i] = bus.forward_distances[i - 1]
+                                   + GetRoadDistance(stop_indexs[i - 1], stop_indexs[i]);
+        bus.ideal_length += geo::ComputeDistance({stop_lats_[stop_indexs[i - 1]], stop_lngs_[stop_indexs[i - 1]]},
+                                                 {stop_lats_[stop_indexs[i]], stop_lngs_[stop_indexs[i]]});
+    }
+    bus.length = stop_indexs.empty() ? 0 : bus.forward_distances.back();
+    if (!bus.ring) {
+        const size_t last = stop_indexs.size() - 1;
+        for (size_t i = 1; i < stop_indexs.size(); ++i) {
+            bus.backward_distances[i] = bus.backward_distances[i - 1]
+                                        + GetRoadDistance(stop_indexs[last - i + 1], stop_indexs[last - i]);
+        }
+        bus.length += stop_indexs.empty() ? 0 : bus.backward_distances.back();
+        bus.ideal_length *= 2;
+    }
+}
     
-const Stop& TransportCatalogue::AddStop(string name, geo::Coordinates coordinates) {
-    Stop& stop = stops_.emplace_back(Stop{move(name), move(coordinates)});
-    stop_index_by_name_.insert({stop.name, stops_.size() - 1});
-    return stop;
+TransportCatalogue::TransportCatalogue(TransportCatalogue&& other) {
+    *this = move(other);
+}
+
+TransportCatalogue& TransportCatalogue::operator=(TransportCatalogue&& other) {
+    if (this == &other) {
+        return *this;
+    }
+    buses_ = move(other.buses_);
+    bus_index_by_name_ = move(other.bus_index_by_name_);
+    stop_lats_ = move(other.stop_lats_);
+    stop_lngs_ = move(other.stop_lngs_);
+    stop_names_ = move(other.stop_names_);
+    stop_name_offsets_ = move(other.stop_name_offsets_);
+    distance_offsets_ = move(other.distance_offsets_);
+    distance_stop_indexs_ = move(other.distance_stop_indexs_);
+    distances_ = move(other.distances_);
+    stop_bus_offsets_ = move(other.stop_bus_offsets_);
+    stop_bus_indexs_ = move(other.stop_bus_indexs_);
+    new_distances_ = move(other.new_distances_);
+    finalized_bus_count_ = other.finalized_bus_count_;
+    other.stop_index_by_name_.clear();
+    IndexStopNames();
+    return *this;
+}
+
+size_t TransportCatalogue::AddStop(string_view name, geo::Coordinates coordinates) {
+    const size_t stop_index = GetStopCount();
+    const char* names = stop_names_.data();
+    stop_names_.append(name);
+    stop_name_offsets_.push_back(stop_names_.size());
+    stop_lats_.push_back(coordinates.lat);
+    stop_lngs_.push_back(coordinates.lng);
+    distance_offsets_.push_back(distance_offsets_.back());
+    if (stop_bus_offsets_.size() == stop_index + 1) {
+        stop_bus_offsets_.push_back(stop_bus_offsets_.back());
+    }
+
+    // Names are looked up by views into stop_names_, which moves as it grows.
+    if (stop_names_.data() != names) {
+        IndexStopNames();
+    } else {
+        stop_index_by_name_.insert({GetStopName(stop_index), stop_index});
+    }
+    return stop_index;
 }
     
 const Bus& TransportCatalogue::FindBus(size_t index) const {
@@ -84,27 +119,194 @@ const Bus* TransportCatalogue::FindBus(string_view name) const {
     return bus != bus_index_by_name_.end() ? &buses_[bus->second] : nullptr;
 }
     
-const Stop& TransportCatalogue::FindStop(size_t index) const {
-    return stops_[index];
+Stop TransportCatalogue::FindStop(size_t index) const {
+    // Buses added since the last Finalize have unpacked the rows of buses.
+    if (stop_bus_offsets_.size() != GetStopCount() + 1) {
+        return {GetStopName(index), {stop_lats_[index], stop_lngs_[index]},
+                {stop_bus_indexs_.end(), stop_bus_indexs_.end()}};
+    }
+    return {GetStopName(index), {stop_lats_[index], stop_lngs_[index]},
+            {stop_bus_indexs_.begin() + stop_bus_offsets_[index], stop_bus_indexs_.begin() + stop_bus_offsets_[index + 1]}};
+}
+
+size_t TransportCatalogue::GetBusCount() const {
+    return buses_.size();
+}
+
+size_t TransportCatalogue::GetStopCount() const {
+    return stop_lats_.size();
 }
 
 size_t TransportCatalogue::IndexStop(std::string_view name) const {
     return stop_index_by_name_.at(name);
 }
     
-const Stop* TransportCatalogue::FindStop(string_view name) const {
+optional<Stop> TransportCatalogue::FindStop(string_view name) const {
     auto stop = stop_index_by_name_.find(name);
-    return stop != stop_index_by_name_.end() ? &stops_[stop->second] : nullptr;
+    if (stop == stop_index_by_name_.end()) {
+        return nullopt;
+    }
+    return FindStop(stop->second);
 }
     
 void TransportCatalogue::SetDistanceBetweenStops(
     string_view stop1, string_view stop2, int distance)
 {
-    stops_[stop_index_by_name_.at(stop1)].distance_to_stops.emplace(
-        stop_index_by_name_.at(stop2), distance);
+    new_distances_.push_back({stop_index_by_name_.at(stop1), stop_index_by_name_.at(stop2), distance});
+}
+
+void TransportCatalogue::SetBusDepartures(string_view name, vector<double> departures) {
+    sort(departures.begin(), departures.end());
+    buses_[bus_index_by_name_.at(name)].departures = move(departures);
+}
+
+int TransportCatalogue::GetRoadDistance(size_t from_stop_index, size_t to_stop_index) const {
+    if (const optional<int> distance = FindDistance(from_stop_index, to_stop_index)) {
+        return *distance;
+    }
+    return FindDistance(to_stop_index, from_stop_index).value();
+}
+
+void TransportCatalogue::Finalize() {
+    FinalizeStopBuses();
+    // New buses, and the ones through both stops of a changed distance, which they ride.
+    vector<bool> changed_buses(buses_.size(), false);
+    fill(changed_buses.begin() + finalized_bus_count_, changed_buses.end(), true);
+    for (const RoadDistance& road_distance : new_distances_) {
+        const auto first = stop_bus_indexs_.begin() + stop_bus_offsets_[road_distance.to_stop_index];
+        const auto last = stop_bus_indexs_.begin() + stop_bus_offsets_[road_distance.to_stop_index + 1];
+        for (size_t i = stop_bus_offsets_[road_distance.from_stop_index];
+             i < stop_bus_offsets_[road_distance.from_stop_index + 1]; ++i) {
+            if (find(first, last, stop_bus_indexs_[i]) != last) {
+                changed_buses[stop_bus_indexs_[i]] = true;
+            }
+        }
+    }
+    FinalizeDistances();
+    for (size_t bus_index = 0; bus_index < buses_.size(); ++bus_index) {
+        if (changed_buses[bus_index]) {
+            ComputeBusDistances(buses_[bus_index]);
+        }
+    }
+    finalized_bus_count_ = buses_.size();
+}
+
+bool TransportCatalogue::IsFinalized() const {
+    return new_distances_.empty() && finalized_bus_count_ == buses_.size()
+           && stop_bus_offsets_.size() == GetStopCount() + 1;
+}
+
+StopStats TransportCatalogue::GetStopStats() const {
+    StopStats stats;
+    stats.stop_count = GetStopCount();
+    stats.byte_count = (stop_lats_.capacity() + stop_lngs_.capacity()) * sizeof(double)
+                       + stop_names_.capacity()
+                       + (stop_name_offsets_.capacity() + distance_offsets_.capacity()
+                          + distance_stop_indexs_.capacity() + stop_bus_offsets_.capacity()
+                          + stop_bus_indexs_.capacity()) * sizeof(size_t)
+                       + distances_.capacity() * sizeof(int);
+    return stats;
+}
+
+void TransportCatalogue::IndexStopNames() {
+    stop_index_by_name_.clear();
+    for (size_t i = 0; i < GetStopCount(); ++i) {
+        stop_index_by_name_.insert({GetStopName(i), i});
+    }
+}
+
+string_view TransportCatalogue::GetStopName(size_t index) const {
+    return string_view(stop_names_).substr(stop_name_offsets_[index],
+                                           stop_name_offsets_[index + 1] - stop_name_offsets_[index]);
+}
+
+optional<int> TransportCatalogue::FindDistance(size_t from_stop_index, size_t to_stop_index) const {
+    assert(new_distances_.empty());
+    const auto first = distance_stop_indexs_.begin() + distance_offsets_[from_stop_index];
+    const auto last = distance_stop_indexs_.begin() + distance_offsets_[from_stop_index + 1];
+    const auto it = lower_bound(first, last, to_stop_index);
+    if (it == last || *it != to_stop_index) {
+        return nullopt;
+    }
+    return distances_[it - distance_stop_indexs_.begin()];
+}
+
+void TransportCatalogue::FinalizeDistances() {
+    if (new_distances_.empty()) {
+        return;
+    }
+    vector<RoadDistance> road_distances;
+    road_distances.reserve(distances_.size() + new_distances_.size());
+    for (size_t from_stop_index = 0; from_stop_index < GetStopCount(); ++from_stop_index) {
+        for (size_t i = distance_offsets_[from_stop_index]; i < distance_offsets_[from_stop_index + 1]; ++i) {
+            road_distances.push_back({from_stop_index, distance_stop_indexs_[i], distances_[i]});
+        }
+    }
+    road_distances.insert(road_distances.end(), new_distances_.begin(), new_distances_.end());
+    new_distances_.clear();
+    stable_sort(road_distances.begin(), road_distances.end(), [](const RoadDistance& lhs, const RoadDistance& rhs) {
+        return pair(lhs.from_stop_index, lhs.to_stop_index) < pair(rhs.from_stop_index, rhs.to_stop_index);
+    });
+
+    distance_offsets_.assign(GetStopCount() + 1, 0);
+    distance_stop_indexs_.clear();
+    distances_.clear();
+    for (size_t i = 0; i < road_distances.size(); ++i) {
+        const RoadDistance& road_distance = road_distances[i];
+        // A later distance between the same stops replaces the earlier one.
+        if (i + 1 < road_distances.size()
+            && road_distances[i + 1].from_stop_index == road_distance.from_stop_index
+            && road_distances[i + 1].to_stop_index == road_distance.to_stop_index) {
+            continue;
+        }
+        ++distance_offsets_[road_distance.from_stop_index + 1];
+        distance_stop_indexs_.push_back(road_distance.to_stop_index);
+        distances_.push_back(road_distance.distance);
+    }
+    partial_sum(distance_offsets_.begin(), distance_offsets_.end(), distance_offsets_.begin());
+}
+
+void TransportCatalogue::FinalizeStopBuses() {
+    if (stop_bus_offsets_.size() == GetStopCount() + 1) {
+        return;
+    }
+    vector<size_t> bus_indexs(buses_.size());
+    iota(bus_indexs.begin(), bus_indexs.end(), 0);
+    sort(bus_indexs.begin(), bus_indexs.end(), [this](size_t lhs, size_t rhs) {
+        return buses_[lhs].name < buses_[rhs].name;
+    });
+
+    // A bus passing a stop more than once is listed there once.
+    constexpr size_t no_bus = numeric_limits<size_t>::max();
+    vector<size_t> last_bus_indexs(GetStopCount(), no_bus);
+    stop_bus_offsets_.assign(GetStopCount() + 1, 0);
+    for (const size_t bus_index : bus_indexs) {
+        for (const size_t stop_index : buses_[bus_index].stop_indexs) {
+            if (last_bus_indexs[stop_index] != bus_index) {
+                last_bus_indexs[stop_index] = bus_index;
+                ++stop_bus_offsets_[stop_index + 1];
+            }
+        }
+    }
+    partial_sum(stop_bus_offsets_.begin(), stop_bus_offsets_.end(), stop_bus_offsets_.begin());
+
+    stop_bus_indexs_.resize(stop_bus_offsets_.back());
+    vector<size_t> positions(stop_bus_offsets_.begin(), stop_bus_offsets_.end() - 1);
+    last_bus_indexs.assign(GetStopCount(), no_bus);
+    for (const size_t bus_index : bus_indexs) {
+        for (const size_t stop_index : buses_[bus_index].stop_indexs) {
+            if (last_bus_indexs[stop_index] != bus_index) {
+                last_bus_indexs[stop_index] = bus_index;
+                stop_bus_indexs_[positions[stop_index]++] = bus_index;
+            }
+        }
+    }
 }
     
 proto::TransportCatalogue TransportCatalogue::OutProto() const {
+    if (!IsFinalized()) {
+        throw logic_error("Catalogue should be finalized before serialization");
+    }
     proto::TransportCatalogue proto_transport_catalogue;
 
     for (int i = 0; i < buses_.size(); ++i) {
@@ -120,33 +322,34 @@ proto::TransportCatalogue TransportCatalogue::OutProto() const {
         proto_bus.set_ideal_length(bus.ideal_length);
         proto_bus.set_count_stops(bus.count_stops);
         proto_bus.set_count_unique_stops(bus.count_unique_stops);
+        for (const double departure : bus.departures) {
+            proto_bus.add_departure(departure);
+        }
 
         proto_transport_catalogue.add_bus();
         *proto_transport_catalogue.mutable_bus(i) = move(proto_bus);
     }
 
-    for (int i = 0; i < stops_.size(); ++i) {
-        const Stop& stop = stops_[i];
-
+    for (size_t i = 0; i < GetStopCount(); ++i) {
         proto::Stop proto_stop;
-        proto_stop.set_name(stop.name);
+        proto_stop.set_name(string(GetStopName(i)));
         {
             proto::Coordinates proto_coordinates;
-            proto_coordinates.set_lat(stop.coordinates.lat);
-            proto_coordinates.set_lng(stop.coordinates.lng);
+            proto_coordinates.set_lat(stop_lats_[i]);
+            proto_coordinates.set_lng(stop_lngs_[i]);
 
             *proto_stop.mutable_coordinates() = move(proto_coordinates);
         }
-        for (const auto& [stop_index, distance] : stop.distance_to_stops) {
+        for (size_t j = distance_offsets_[i]; j < distance_offsets_[i + 1]; ++j) {
             proto::DistanceToStop proto_distance_to_stop;
-            proto_distance_to_stop.set_stop_index(stop_index);
-            proto_distance_to_stop.set_distance(distance);
+            proto_distance_to_stop.set_stop_index(distance_stop_indexs_[j]);
+            proto_distance_to_stop.set_distance(distances_[j]);
 
             proto_stop.add_distance_to_stop();
             *proto_stop.mutable_distance_to_stop(proto_stop.distance_to_stop_size() - 1) = move(proto_distance_to_stop);
         }
-        for (const size_t bus_index : stop.bus_indexs) {
-            proto_stop.add_bus_index(bus_index);
+        for (size_t j = stop_bus_offsets_[i]; j < stop_bus_offsets_[i + 1]; ++j) {
+            proto_stop.add_bus_index(stop_bus_indexs_[j]);
         }
 
         proto_transport_catalogue.add_stop();
@@ -157,7 +360,7 @@ proto::TransportCatalogue TransportCatalogue::OutProto() const {
 }
    
 void TransportCatalogue::InProto(const proto::TransportCatalogue& proto_transport_catalogue) {
-    bus_index_by_name_.clear();
+    *this = TransportCatalogue();
     buses_.resize(proto_transport_catalogue.bus_size());
     for (int i = 0; i < proto_transport_catalogue.bus_size(); ++i) {
         const proto::Bus& proto_bus = proto_transport_catalogue.bus(i);
@@ -170,39 +373,29 @@ void TransportCatalogue::InProto(const proto::TransportCatalogue& proto_transpor
         
         Bus bus{proto_bus.name(), move(stop_indexs), proto_bus.ring(),
                 proto_bus.length(), proto_bus.ideal_length(),
-                proto_bus.count_stops(), proto_bus.count_unique_stops()};
+                proto_bus.count_stops(), proto_bus.count_unique_stops(),
+                {proto_bus.departure().begin(), proto_bus.departure().end()}};
         buses_[i] = move(bus);
         bus_index_by_name_.insert({buses_[i].name, i});
     }
     
-    stop_index_by_name_.clear();
-    stops_.resize(proto_transport_catalogue.stop_size());
     for (int i = 0; i < proto_transport_catalogue.stop_size(); ++i) {
         const proto::Stop& proto_stop = proto_transport_catalogue.stop(i);
-
-        geo::Coordinates coordinates{proto_stop.coordinates().lat(),
-                                     proto_stop.coordinates().lng()};
-        
-        unordered_map<size_t, int> distance_to_stops;
+        AddStop(proto_stop.name(), {proto_stop.coordinates().lat(), proto_stop.coordinates().lng()});
         for (int j = 0; j < proto_stop.distance_to_stop_size(); ++j) {
-            const proto::DistanceToStop& proto_distance_to_stop =
-                proto_stop.distance_to_stop(j);
-            
-            distance_to_stops.insert({proto_distance_to_stop.stop_index(),
+            const proto::DistanceToStop& proto_distance_to_stop = proto_stop.distance_to_stop(j);
+            new_distances_.push_back({static_cast<size_t>(i), proto_distance_to_stop.stop_index(),
                                       proto_distance_to_stop.distance()});
         }
-        
-        vector<size_t> bus_indexs;
-        bus_indexs.reserve(proto_stop.bus_index_size());
-        for (int j = 0; j < proto_stop.bus_index_size(); ++j) {
-            bus_indexs.push_back(proto_stop.bus_index(j));
-        }
-        
-        Stop stop{proto_stop.name(), move(coordinates),
-                  move(distance_to_stops), move(bus_indexs)};
-        stops_[i] = move(stop);
-        stop_index_by_name_.insert({stops_[i].name, i});
     }
+    for (int i = 0; i < proto_transport_catalogue.stop_size(); ++i) {
+        const proto::Stop& proto_stop = proto_transport_catalogue.stop(i);
+        stop_bus_indexs_.insert(stop_bus_indexs_.end(), proto_stop.bus_index().begin(), proto_stop.bus_index().end());
+        stop_bus_offsets_[i + 1] = stop_bus_indexs_.size();
+    }
+
+    // The distances along the buses are cheap to add up again and aren't stored.
+    Finalize();
 }
     
 } //namespace transport
\ No newline at end of file
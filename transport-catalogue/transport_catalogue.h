@@ -5,6 +5,7 @@
 #include "domain.h"
 #include <unordered_map>
 #include <deque>
+#include <optional>
 #include <vector>
 #include <string>
 #include <string_view>
@@ -12,29 +13,93 @@
 
 namespace transport {
 
+// Bytes the stops take in the catalogue, names included.
+struct StopStats {
+    size_t stop_count = 0;
+    size_t byte_count = 0;
+};
+
+// Stops are kept in arrays: coordinates, names in one string, and the road distances and
+// buses of every stop in compressed rows. Changes to the distances and buses come into the
+// rows and the buses' distances with Finalize, and only a finalized catalogue can be read.
 class TransportCatalogue final {
 public:
+    TransportCatalogue() = default;
+    // The indexes by name hold views into the catalogue's own names, so a copy would look
+    // names up in the original.
+    TransportCatalogue(const TransportCatalogue&) = delete;
+    TransportCatalogue& operator=(const TransportCatalogue&) = delete;
+    // A short stop_names_ moves its characters along, so the moves index the names anew.
+    TransportCatalogue(TransportCatalogue&& other);
+    TransportCatalogue& operator=(TransportCatalogue&& other);
+
     const domain::Bus& AddBus(std::string name, std::vector<std::string_view> names_stops, bool ring);
-    const domain::Stop& AddStop(std::string name, geo::Coordinates coordinates);
+    // Returns the index of the stop. A finalized catalogue stays finalized.
+    size_t AddStop(std::string_view name, geo::Coordinates coordinates);
     
     const domain::Bus& FindBus(size_t index) const;
     size_t IndexBus(std::string_view name) const;
     const domain::Bus* FindBus(std::string_view name) const;
-    const domain::Stop& FindStop(size_t index) const;
+    domain::Stop FindStop(size_t index) const;
     size_t IndexStop(std::string_view name) const;
-    const domain::Stop* FindStop(std::string_view name) const;
+    std::optional<domain::Stop> FindStop(std::string_view name) const;
     
+    size_t GetBusCount() const;
+    size_t GetStopCount() const;
+    
+    // A later distance between the same stops replaces the earlier one, and the lengths
+    // of the buses through both stops follow.
     void SetDistanceBetweenStops(
         std::string_view stop1, std::string_view stop2, int distance);
+    void SetBusDepartures(std::string_view name, std::vector<double> departures);
+
+    // The road distance from one stop to the next, or the one back when it isn't given.
+    int GetRoadDistance(size_t from_stop_index, size_t to_stop_index) const;
+
+    void Finalize();
+    bool IsFinalized() const;
+
+    StopStats GetStopStats() const;
     
     proto::TransportCatalogue OutProto() const;
     void InProto(const proto::TransportCatalogue& proto_transport_catalogue);
     
-private:  
+private:
+    struct RoadDistance {
+        size_t from_stop_index;
+        size_t to_stop_index;
+        int distance;
+    };
+
+    std::string_view GetStopName(size_t index) const;
+    void IndexStopNames();
+    std::optional<int> FindDistance(size_t from_stop_index, size_t to_stop_index) const;
+    // The distances along the bus and its length.
+    void ComputeBusDistances(domain::Bus& bus) const;
+    void FinalizeDistances();
+    void FinalizeStopBuses();
+
     std::deque<domain::Bus> buses_;
-    std::deque<domain::Stop> stops_;
     std::unordered_map<std::string_view, size_t> bus_index_by_name_;
+
+    std::vector<double> stop_lats_;
+    std::vector<double> stop_lngs_;
+    // The name of stop i is stop_names_ from stop_name_offsets_[i] to stop_name_offsets_[i + 1].
+    std::string stop_names_;
+    std::vector<size_t> stop_name_offsets_ = {0};
     std::unordered_map<std::string_view, size_t> stop_index_by_name_;
+    // The distances set from stop i, by the stop they lead to, are at distance_offsets_[i]
+    // up to distance_offsets_[i + 1].
+    std::vector<size_t> distance_offsets_ = {0};
+    std::vector<size_t> distance_stop_indexs_;
+    std::vector<int> distances_;
+    // Likewise the buses through the stops.
+    std::vector<size_t> stop_bus_offsets_ = {0};
+    std::vector<size_t> stop_bus_indexs_;
+
+    // Set since the last Finalize.
+    std::vector<RoadDistance> new_distances_;
+    size_t finalized_bus_count_ = 0;
 };
     
 } //namespace transport
\ No newline at end of file
@@ -1,9 +1,88 @@
+#define _USE_MATH_DEFINES
 #include "transport_router.h"
+#include "astar_router.h"
+#include "dijkstra_router.h"
+#include "compact_router.h"
+#include "contraction_hierarchy.h"
+#include "hub_label_router.h"
+#include "landmark_router.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 
 using namespace std;
 
 namespace transport_router {
 
+namespace {
+
+// Stops as points of the unit sphere. The chord between two stops is never longer
+// than the arc between them, and unlike the arc it needs no trigonometry per query.
+struct SpherePoint {
+    double x;
+    double y;
+    double z;
+};
+
+SpherePoint ToSpherePoint(geo::Coordinates coordinates) {
+    constexpr double dr = M_PI / 180.0;
+    return { cos(coordinates.lat * dr) * cos(coordinates.lng * dr),
+             cos(coordinates.lat * dr) * sin(coordinates.lng * dr),
+             sin(coordinates.lat * dr) };
+}
+
+double ComputeChord(const SpherePoint& from, const SpherePoint& to) {
+    return sqrt((from.x - to.x) * (from.x - to.x) + (from.y - to.y) * (from.y - to.y)
+                + (from.z - to.z) * (from.z - to.z));
+}
+
+// Road distances don't have to be longer than the straight line between the stops, so
+// the bound takes the least time per chord unit over the edges of the graph rather than
+// the bus velocity. Every edge is at least that slow, hence so is every route.
+graph::AStarRouter<double>::LowerBound CreateGeoLowerBound(
+    const graph::DirectedWeightedGraph<double>& transport_graph,
+    const vector<geo::Coordinates>& vertex_coordinates)
+{
+    if (vertex_coordinates.size() != transport_graph.GetVertexCount()) {
+        throw invalid_argument("Coordinates don't match the vertices of the graph");
+    }
+
+    vector<SpherePoint> points(vertex_coordinates.size());
+    transform(vertex_coordinates.begin(), vertex_coordinates.end(), points.begin(), ToSpherePoint);
+
+    double time_per_chord = numeric_limits<double>::infinity();
+    for (graph::EdgeId edge_id = 0; edge_id < transport_graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = transport_graph.GetEdge(edge_id);
+        const double chord = ComputeChord(points[edge.from], points[edge.to]);
+        if (chord > 0) {
+            time_per_chord = min(time_per_chord, edge.weight / chord);
+        }
+    }
+    if (isinf(time_per_chord)) {
+        time_per_chord = 0;
+    }
+
+    return [points = move(points), time_per_chord](graph::VertexId from, graph::VertexId to) {
+        return time_per_chord * ComputeChord(points[from], points[to]);
+    };
+}
+
+// Buses taken along each edge: a line graph ride counts at its boarding edge.
+vector<uint32_t> CountRides(const graph::DirectedWeightedGraph<double>& transport_graph,
+                            const TransportRoutes& transport_routes) {
+    vector<uint32_t> ride_counts(transport_graph.GetEdgeCount());
+    for (graph::EdgeId edge_id = 0; edge_id < ride_counts.size(); ++edge_id) {
+        const TransportRoutes::EdgeKind kind = transport_routes.GetBusData(edge_id).kind;
+        ride_counts[edge_id] = kind == TransportRoutes::EdgeKind::BUS || kind == TransportRoutes::EdgeKind::BOARDING;
+    }
+    return ride_counts;
+}
+
+} // namespace
+
 TransportRoutes::TransportRoutes(
     RoutingSettings routing_settings,
     vector<BusData> bus_data_by_edge_id,
@@ -31,6 +110,14 @@ graph::VertexId TransportRoutes::GetVertexId(size_t stop_index) const {
     return vertex_id_by_stop_index_.at(stop_index);
 }
 
+void TransportRoutes::Extend(vector<BusData> bus_data_by_edge_id, vector<size_t> stop_index_by_vertex_id) {
+    bus_data_by_edge_id_.insert(bus_data_by_edge_id_.end(), bus_data_by_edge_id.begin(), bus_data_by_edge_id.end());
+    for (const size_t stop_index : stop_index_by_vertex_id) {
+        vertex_id_by_stop_index_.emplace(stop_index, stop_index_by_vertex_id_.size());
+        stop_index_by_vertex_id_.push_back(stop_index);
+    }
+}
+
 proto::TransportRoutes TransportRoutes::OutProto() const {
     proto::TransportRoutes proto_transport_routes;
 
@@ -38,6 +125,9 @@ proto::TransportRoutes TransportRoutes::OutProto() const {
         proto::RoutingSettings proto_routing_settings;
         proto_routing_settings.set_bus_wait_time(routing_settings_.bus_wait_time);
         proto_routing_settings.set_bus_velocity(routing_settings_.bus_velocity);
+        proto_routing_settings.set_router_type(static_cast<proto::RouterType>(routing_settings_.router_type));
+        proto_routing_settings.set_landmark_count(routing_settings_.landmark_count);
+        proto_routing_settings.set_graph_model(static_cast<proto::GraphModel>(routing_settings_.graph_model));
 
         *proto_transport_routes.mutable_routing_settings() = move(proto_routing_settings);
     }
@@ -45,6 +135,7 @@ proto::TransportRoutes TransportRoutes::OutProto() const {
         proto::BusData proto_bus_data;
         proto_bus_data.set_index(bus_data_by_edge_id_[i].index);
         proto_bus_data.set_span_count(bus_data_by_edge_id_[i].span_count);
+        proto_bus_data.set_kind(static_cast<proto::EdgeKind>(bus_data_by_edge_id_[i].kind));
 
         proto_transport_routes.add_bus_data_by_edge_id();
         *proto_transport_routes.mutable_bus_data_by_edge_id(i) = move(proto_bus_data);
@@ -66,13 +157,17 @@ proto::TransportRoutes TransportRoutes::OutProto() const {
 
 void TransportRoutes::InProto(const proto::TransportRoutes& proto_transport_routes) {
     routing_settings_ = { proto_transport_routes.routing_settings().bus_wait_time(),
-        proto_transport_routes.routing_settings().bus_velocity() };
+        proto_transport_routes.routing_settings().bus_velocity(),
+        static_cast<RouterType>(proto_transport_routes.routing_settings().router_type()),
+        proto_transport_routes.routing_settings().landmark_count(),
+        static_cast<GraphModel>(proto_transport_routes.routing_settings().graph_model()) };
 
     bus_data_by_edge_id_.resize(proto_transport_routes.bus_data_by_edge_id_size());
     for (int i = 0; i < proto_transport_routes.bus_data_by_edge_id_size(); ++i) {
         const proto::BusData& proto_bus_data = proto_transport_routes.bus_data_by_edge_id(i);
 
-        bus_data_by_edge_id_[i] = { proto_bus_data.index(), proto_bus_data.span_count() };
+        bus_data_by_edge_id_[i] = { proto_bus_data.index(), proto_bus_data.span_count(),
+                                    static_cast<EdgeKind>(proto_bus_data.kind()) };
     }
 
     stop_index_by_vertex_id_.resize(proto_transport_routes.stop_index_by_vertex_id_size());
@@ -88,4 +183,449 @@ void TransportRoutes::InProto(const proto::TransportRoutes& proto_transport_rout
     }
 }
 
+optional<Route> RouteBuilder::BuildRouteAt(size_t from_stop_index, size_t to_stop_index,
+                                           double /*departure_time*/) const {
+    return BuildRoute(from_stop_index, to_stop_index);
+}
+
+vector<Route> RouteBuilder::BuildAlternativeRoutes(size_t from_stop_index, size_t to_stop_index,
+                                                   size_t count) const {
+    vector<Route> routes;
+    if (count > 0) {
+        if (auto route = BuildRoute(from_stop_index, to_stop_index)) {
+            routes.push_back(move(*route));
+        }
+    }
+    return routes;
+}
+
+vector<optional<Route>> RouteBuilder::BuildRoutes(size_t from_stop_index,
+                                                  const vector<size_t>& to_stop_indexs) const {
+    vector<optional<Route>> routes;
+    routes.reserve(to_stop_indexs.size());
+    for (const size_t to_stop_index : to_stop_indexs) {
+        routes.push_back(BuildRoute(from_stop_index, to_stop_index));
+    }
+    return routes;
+}
+
+ClosureFlags::ClosureFlags(size_t stop_count, size_t bus_count)
+: stops_(stop_count, false)
+, buses_(bus_count, false) {
+}
+
+void ClosureFlags::Set(const Closures& closures) {
+    fill(stops_.begin(), stops_.end(), false);
+    fill(buses_.begin(), buses_.end(), false);
+    Add(closures);
+}
+
+Closures ClosureFlags::Add(const Closures& closures) {
+    if (any_of(closures.stop_indexs.begin(), closures.stop_indexs.end(),
+               [this](size_t index) { return index >= stops_.size(); })) {
+        throw out_of_range("Stop is out of range");
+    }
+    if (any_of(closures.bus_indexs.begin(), closures.bus_indexs.end(),
+               [this](size_t index) { return index >= buses_.size(); })) {
+        throw out_of_range("Bus is out of range");
+    }
+
+    Closures added;
+    for (const size_t stop_index : closures.stop_indexs) {
+        if (!stops_[stop_index]) {
+            stops_[stop_index] = true;
+            added.stop_indexs.push_back(stop_index);
+        }
+    }
+    for (const size_t bus_index : closures.bus_indexs) {
+        if (!buses_[bus_index]) {
+            buses_[bus_index] = true;
+            added.bus_indexs.push_back(bus_index);
+        }
+    }
+    return added;
+}
+
+void ClosureFlags::Reopen(const Closures& closures) {
+    for (const size_t stop_index : closures.stop_indexs) {
+        stops_[stop_index] = false;
+    }
+    for (const size_t bus_index : closures.bus_indexs) {
+        buses_[bus_index] = false;
+    }
+}
+
+GraphRouteBuilder::GraphRouteBuilder(
+    const graph::DirectedWeightedGraph<double>& transport_graph,
+    const TransportRoutes& transport_routes,
+    const graph::RouterBase<double>& router)
+: transport_graph_(transport_graph)
+, transport_routes_(transport_routes)
+, router_(router)
+, closures_mask_(transport_graph.GetVertexCount(), transport_graph.GetEdgeCount()) {
+    for (graph::EdgeId edge_id = 0; edge_id < transport_graph.GetEdgeCount(); ++edge_id) {
+        const size_t bus_index = transport_routes.GetBusData(edge_id).index;
+        if (bus_edge_offsets_.size() < bus_index + 2) {
+            bus_edge_offsets_.resize(bus_index + 2, 0);
+        }
+        ++bus_edge_offsets_[bus_index + 1];
+    }
+    for (size_t bus_index = 1; bus_index < bus_edge_offsets_.size(); ++bus_index) {
+        bus_edge_offsets_[bus_index] += bus_edge_offsets_[bus_index - 1];
+    }
+    bus_edges_.resize(transport_graph.GetEdgeCount());
+    vector<size_t> positions = bus_edge_offsets_;
+    for (graph::EdgeId edge_id = 0; edge_id < transport_graph.GetEdgeCount(); ++edge_id) {
+        bus_edges_[positions[transport_routes.GetBusData(edge_id).index]++] = edge_id;
+    }
+}
+
+optional<Route> GraphRouteBuilder::BuildRoute(size_t from_stop_index, size_t to_stop_index) const {
+    const graph::VertexId from = transport_routes_.GetVertexId(from_stop_index);
+    const graph::VertexId to = transport_routes_.GetVertexId(to_stop_index);
+    const auto weight = has_closures_ ? GetMaskedRouter().BuildRouteInto(from, to, closures_mask_, route_edges_)
+                                      : router_.BuildRouteInto(from, to, route_edges_);
+    if (!weight) {
+        return nullopt;
+    }
+    return MakeRoute(*weight, route_edges_);
+}
+
+vector<optional<Route>> GraphRouteBuilder::BuildRoutes(size_t from_stop_index,
+                                                       const vector<size_t>& to_stop_indexs) const {
+    vector<graph::VertexId> to_vertex_ids;
+    to_vertex_ids.reserve(to_stop_indexs.size());
+    for (const size_t to_stop_index : to_stop_indexs) {
+        to_vertex_ids.push_back(transport_routes_.GetVertexId(to_stop_index));
+    }
+
+    const graph::VertexId from = transport_routes_.GetVertexId(from_stop_index);
+    const auto graph_routes = has_closures_ ? GetMaskedRouter().BuildRoutes(from, to_vertex_ids, closures_mask_)
+                                            : router_.BuildRoutes(from, to_vertex_ids);
+    vector<optional<Route>> routes;
+    routes.reserve(to_stop_indexs.size());
+    for (const auto& route : graph_routes) {
+        routes.push_back(route ? make_optional(MakeRoute(route->weight, route->edges)) : nullopt);
+    }
+    return routes;
+}
+
+vector<Route> GraphRouteBuilder::BuildParetoRoutes(size_t from_stop_index, size_t to_stop_index) const {
+    vector<Route> routes;
+    for (const auto& route : GetParetoRouter().BuildRoutes(
+             transport_routes_.GetVertexId(from_stop_index),
+             transport_routes_.GetVertexId(to_stop_index),
+             GetClosuresMask())) {
+        routes.push_back(MakeRoute(route.weight, route.edges));
+    }
+    return routes;
+}
+
+vector<Route> GraphRouteBuilder::BuildAlternativeRoutes(size_t from_stop_index, size_t to_stop_index,
+                                                        size_t count) const {
+    vector<Route> routes;
+    // Getting off a bus to get back on it only adds the wait, and would otherwise fill the
+    // alternatives with the best route cut up.
+    const auto splits_ride = [this](graph::EdgeId first_edge_id, graph::EdgeId second_edge_id) {
+        return SplitsRide(first_edge_id, second_edge_id);
+    };
+    for (const auto& route : GetYenRouter().BuildRoutes(
+             transport_routes_.GetVertexId(from_stop_index),
+             transport_routes_.GetVertexId(to_stop_index),
+             count,
+             GetClosuresMask(),
+             splits_ride)) {
+        routes.push_back(MakeRoute(route.weight, route.edges));
+    }
+    return routes;
+}
+
+vector<StopArrival> GraphRouteBuilder::FindReachableStops(size_t from_stop_index, double max_weight) const {
+    vector<StopArrival> result;
+    for (const auto& [vertex, weight] :
+         GetIsochroneSearch().Search(transport_routes_.GetVertexId(from_stop_index), max_weight, GetClosuresMask())) {
+        // The line graph's on-board vertices aren't stops.
+        const size_t stop_index = transport_routes_.GetStopIndex(vertex);
+        if (transport_routes_.GetVertexId(stop_index) == vertex) {
+            result.push_back({stop_index, weight});
+        }
+    }
+    return result;
+}
+
+void GraphRouteBuilder::SetClosures(const Closures& closures) {
+    closures_mask_ = graph::GraphMask(transport_graph_.GetVertexCount(), transport_graph_.GetEdgeCount());
+    AddToMask(closures, closures_mask_);
+    has_closures_ = !closures.stop_indexs.empty() || !closures.bus_indexs.empty();
+}
+
+optional<Route> GraphRouteBuilder::BuildRouteAvoiding(size_t from_stop_index, size_t to_stop_index,
+                                                      double /*departure_time*/, const Closures& avoid) const {
+    graph::GraphMask mask = closures_mask_;
+    AddToMask(avoid, mask);
+    const auto route = GetMaskedRouter().BuildRoute(
+        transport_routes_.GetVertexId(from_stop_index),
+        transport_routes_.GetVertexId(to_stop_index),
+        mask);
+    if (!route) {
+        return nullopt;
+    }
+    return MakeRoute(route->weight, route->edges);
+}
+
+bool GraphRouteBuilder::SplitsRide(graph::EdgeId first_edge_id, graph::EdgeId second_edge_id) const {
+    using EdgeKind = TransportRoutes::EdgeKind;
+    const TransportRoutes::BusData& first = transport_routes_.GetBusData(first_edge_id);
+    const TransportRoutes::BusData& second = transport_routes_.GetBusData(second_edge_id);
+    if (first.index != second.index) {
+        return false;
+    }
+    const graph::VertexId from = transport_graph_.GetEdge(first_edge_id).from;
+    const graph::VertexId to = transport_graph_.GetEdge(second_edge_id).to;
+    if (first.kind == EdgeKind::BUS && second.kind == EdgeKind::BUS) {
+        // Rides over the end of a ring, or on through a stop the bus comes back to, have no
+        // edge of their own.
+        for (const graph::EdgeId edge_id : transport_graph_.GetIncidentEdges(from)) {
+            if (transport_graph_.GetEdge(edge_id).to == to
+                && transport_routes_.GetBusData(edge_id).index == first.index) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (first.kind == EdgeKind::ALIGHTING && second.kind == EdgeKind::BOARDING) {
+        // On-board vertices follow the bus, so staying on reaches a later one over riding
+        // edges, unless the bus turns back or comes round the ring in between.
+        if (to <= from) {
+            return false;
+        }
+        for (graph::VertexId vertex = from; vertex < to;) {
+            const auto incident_edges = transport_graph_.GetIncidentEdges(vertex);
+            const auto riding = find_if(incident_edges.begin(), incident_edges.end(),
+                [this](graph::EdgeId edge_id) {
+                    return transport_routes_.GetBusData(edge_id).kind == EdgeKind::RIDING;
+                });
+            if (riding == incident_edges.end()) {
+                return false;
+            }
+            vertex = transport_graph_.GetEdge(*riding).to;
+        }
+        return true;
+    }
+    return false;
+}
+
+void GraphRouteBuilder::AddToMask(const Closures& closures, graph::GraphMask& mask) const {
+    // A stop's vertex is where its rides start and end; the line graph's on-board
+    // vertices ride on through it.
+    for (const size_t stop_index : closures.stop_indexs) {
+        mask.vertices.Set(transport_routes_.GetVertexId(stop_index));
+    }
+    for (const size_t bus_index : closures.bus_indexs) {
+        if (bus_index + 1 >= bus_edge_offsets_.size()) {
+            continue;
+        }
+        for (size_t i = bus_edge_offsets_[bus_index]; i < bus_edge_offsets_[bus_index + 1]; ++i) {
+            mask.edges.Set(bus_edges_[i]);
+        }
+    }
+}
+
+const graph::IsochroneSearch<double>& GraphRouteBuilder::GetIsochroneSearch() const {
+    if (!isochrone_search_) {
+        // Every bus ride in the stop pairs graph takes at least the wait, so buckets that
+        // wide are never pushed to while drained.
+        isochrone_search_.emplace(
+            transport_graph_, max(1.0, static_cast<double>(transport_routes_.GetRoutingSettings().bus_wait_time)));
+    }
+    return *isochrone_search_;
+}
+
+const graph::ParetoRouter<double>& GraphRouteBuilder::GetParetoRouter() const {
+    if (!pareto_router_) {
+        pareto_router_.emplace(transport_graph_, CountRides(transport_graph_, transport_routes_));
+    }
+    return *pareto_router_;
+}
+
+const graph::YenRouter<double>& GraphRouteBuilder::GetYenRouter() const {
+    if (!yen_router_) {
+        yen_router_.emplace(transport_graph_);
+    }
+    return *yen_router_;
+}
+
+const graph::DijkstraRouter<double>& GraphRouteBuilder::GetMaskedRouter() const {
+    if (!masked_router_) {
+        masked_router_.emplace(transport_graph_);
+    }
+    return *masked_router_;
+}
+
+Route GraphRouteBuilder::MakeRoute(double weight, const vector<graph::EdgeId>& edges) const {
+    // Line graph rides come as boarding and riding edges, which fold into one ride.
+    Route result{weight, {}};
+    for (const graph::EdgeId edge_id : edges) {
+        const auto& edge = transport_graph_.GetEdge(edge_id);
+        const auto& bus_data = transport_routes_.GetBusData(edge_id);
+        switch (bus_data.kind) {
+        case TransportRoutes::EdgeKind::BUS:
+        case TransportRoutes::EdgeKind::BOARDING:
+            result.rides.push_back({bus_data.index, transport_routes_.GetStopIndex(edge.from),
+                                    bus_data.span_count, edge.weight,
+                                    static_cast<double>(transport_routes_.GetRoutingSettings().bus_wait_time)});
+            break;
+        case TransportRoutes::EdgeKind::RIDING:
+            result.rides.back().span_count += bus_data.span_count;
+            result.rides.back().weight += edge.weight;
+            break;
+        case TransportRoutes::EdgeKind::ALIGHTING:
+            break;
+        }
+    }
+    return result;
+}
+
+unique_ptr<graph::RouterBase<double>> CreateRouter(
+    const graph::DirectedWeightedGraph<double>& transport_graph,
+    const RoutingSettings& routing_settings,
+    const vector<geo::Coordinates>& vertex_coordinates)
+{
+    return CreateRouter(transport_graph, routing_settings, vertex_coordinates, proto::RouterData{});
+}
+
+unique_ptr<graph::RouterBase<double>> CreateRouter(
+    const graph::DirectedWeightedGraph<double>& transport_graph,
+    const RoutingSettings& routing_settings,
+    const vector<geo::Coordinates>& vertex_coordinates,
+    const proto::RouterData& proto_router_data)
+{
+    switch (routing_settings.router_type) {
+    case RouterType::FLOYD:
+        if (proto_router_data.has_router()) {
+            return make_unique<graph::Router<double>>(transport_graph, proto_router_data.router());
+        }
+        return make_unique<graph::Router<double>>(transport_graph);
+    case RouterType::DIJKSTRA:
+        return make_unique<graph::DijkstraRouter<double>>(transport_graph);
+    case RouterType::FLOYD_FLOAT:
+        if (proto_router_data.has_router()) {
+            return make_unique<graph::CompactRouter<double, float>>(transport_graph, 1, proto_router_data.router());
+        }
+        return make_unique<graph::CompactRouter<double, float>>(transport_graph, 1);
+    case RouterType::FLOYD_FIXED_POINT:
+        if (proto_router_data.has_router()) {
+            return make_unique<graph::CompactRouter<double, int32_t>>(
+                transport_graph, FIXED_POINT_SCALE, proto_router_data.router());
+        }
+        return make_unique<graph::CompactRouter<double, int32_t>>(transport_graph, FIXED_POINT_SCALE);
+    case RouterType::CONTRACTION_HIERARCHY:
+        if (proto_router_data.has_contraction_hierarchy()) {
+            return make_unique<graph::ContractionHierarchy<double>>(
+                transport_graph, proto_router_data.contraction_hierarchy());
+        }
+        return make_unique<graph::ContractionHierarchy<double>>(transport_graph);
+    case RouterType::A_STAR:
+        return make_unique<graph::AStarRouter<double>>(
+            transport_graph, CreateGeoLowerBound(transport_graph, vertex_coordinates));
+    case RouterType::LANDMARKS:
+        if (proto_router_data.has_landmarks()) {
+            return make_unique<graph::LandmarkRouter<double>>(transport_graph, proto_router_data.landmarks());
+        }
+        return make_unique<graph::LandmarkRouter<double>>(transport_graph, routing_settings.landmark_count);
+    case RouterType::HUB_LABELS:
+        if (proto_router_data.has_hub_labels()) {
+            return make_unique<graph::HubLabelRouter<double>>(transport_graph, proto_router_data.hub_labels());
+        }
+        return make_unique<graph::HubLabelRouter<double>>(transport_graph);
+    case RouterType::RAPTOR:
+    case RouterType::CSA:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+bool IsApproximateRouter(RouterType router_type) {
+    return router_type == RouterType::FLOYD_FLOAT || router_type == RouterType::FLOYD_FIXED_POINT;
+}
+
+bool IsSearchRouter(RouterType router_type) {
+    return router_type == RouterType::DIJKSTRA || router_type == RouterType::CONTRACTION_HIERARCHY
+        || router_type == RouterType::A_STAR || router_type == RouterType::LANDMARKS;
+}
+
+size_t EstimateRouterMemory(RouterType router_type, size_t vertex_count, size_t edge_count,
+                            const RoutingSettings& routing_settings) {
+    // A search keeps a search id, a weight, a bound and a prev edge for every vertex.
+    const size_t search_byte_count =
+        vertex_count * (sizeof(uint32_t) + 2 * sizeof(double) + sizeof(optional<graph::EdgeId>));
+    // Precomputed data is there twice at the peak: in the router and in the base as it's
+    // written, or as the router is read from it.
+    constexpr size_t DATA_COPY_COUNT = 2;
+    const size_t cell_count = vertex_count * vertex_count;
+    switch (router_type) {
+    case RouterType::FLOYD:
+        return DATA_COPY_COUNT * cell_count * (sizeof(double) + sizeof(graph::EdgeId));
+    case RouterType::FLOYD_FLOAT:
+    case RouterType::FLOYD_FIXED_POINT:
+        // The table over a compact copy of the graph.
+        return DATA_COPY_COUNT * cell_count * (sizeof(float) + sizeof(graph::EdgeId))
+            + edge_count * (sizeof(graph::Edge<float, graph::GraphIndex>) + sizeof(graph::GraphIndex))
+            + (vertex_count + 1) * sizeof(graph::GraphIndex);
+    case RouterType::HUB_LABELS: {
+        // Labels of our networks average up to about 2 sqrt(V) hubs each way; 3 sqrt(V) leaves a margin.
+        const size_t entry_count = 2 * vertex_count * static_cast<size_t>(3 * sqrt(vertex_count) + 1);
+        return DATA_COPY_COUNT * (entry_count * (sizeof(uint32_t) + sizeof(double) + sizeof(graph::EdgeId))
+                                  + 2 * (vertex_count + 1) * sizeof(size_t));
+    }
+    case RouterType::CONTRACTION_HIERARCHY:
+        // Up to a shortcut per edge, the upward edges both ways, ranks and two searches.
+        return DATA_COPY_COUNT * edge_count * (sizeof(graph::Edge<double>) + 2 * sizeof(graph::EdgeId))
+            + 2 * (2 * edge_count) * sizeof(graph::EdgeId)
+            + vertex_count * 3 * sizeof(size_t) + 2 * search_byte_count;
+    case RouterType::LANDMARKS:
+        // The router takes no more landmarks than there are vertices.
+        return DATA_COPY_COUNT * 2 * min(routing_settings.landmark_count, vertex_count) * vertex_count * sizeof(double)
+            + search_byte_count;
+    case RouterType::A_STAR:
+    case RouterType::DIJKSTRA:
+        return search_byte_count;
+    case RouterType::RAPTOR:
+    case RouterType::CSA:
+        return 0;
+    }
+    return 0;
+}
+
+RouterType SelectRouterType(const RoutingSettings& routing_settings, size_t vertex_count, size_t edge_count) {
+    // Graph routers from the fastest to answer to the slowest.
+    static constexpr array ROUTER_TYPES_BY_SPEED{
+        RouterType::FLOYD,
+        RouterType::FLOYD_FLOAT,
+        RouterType::FLOYD_FIXED_POINT,
+        RouterType::HUB_LABELS,
+        RouterType::CONTRACTION_HIERARCHY,
+        RouterType::LANDMARKS,
+        RouterType::A_STAR,
+        RouterType::DIJKSTRA
+    };
+    const auto chosen = find(ROUTER_TYPES_BY_SPEED.begin(), ROUTER_TYPES_BY_SPEED.end(), routing_settings.router_type);
+    if (routing_settings.max_router_memory_mb == 0 || chosen == ROUTER_TYPES_BY_SPEED.end()) {
+        return routing_settings.router_type;
+    }
+    constexpr size_t BYTES_PER_MB = 1024 * 1024;
+    const size_t max_byte_count = routing_settings.max_router_memory_mb > numeric_limits<size_t>::max() / BYTES_PER_MB
+        ? numeric_limits<size_t>::max()
+        : routing_settings.max_router_memory_mb * BYTES_PER_MB;
+    for (auto it = chosen; it != ROUTER_TYPES_BY_SPEED.end(); ++it) {
+        if (it != chosen && IsApproximateRouter(*it)) {
+            continue;
+        }
+        if (EstimateRouterMemory(*it, vertex_count, edge_count, routing_settings) <= max_byte_count) {
+            return *it;
+        }
+    }
+    return RouterType::DIJKSTRA;
+}
+
 } // namespace transport_router
\ No newline at end of file
@@ -1,22 +1,81 @@
 #pragma once
+#include "dijkstra_router.h"
+#include "geo.h"
 #include "graph.h"
+#include "graph_mask.h"
+#include "isochrone.h"
+#include "pareto_router.h"
+#include "router.h"
+#include "yen_router.h"
 #include <transport_router.pb.h>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <unordered_map>
 
 namespace transport_router {
 
+enum class RouterType {
+    FLOYD,
+    DIJKSTRA,
+    FLOYD_FLOAT,
+    FLOYD_FIXED_POINT,
+    CONTRACTION_HIERARCHY,
+    A_STAR,
+    LANDMARKS,
+    HUB_LABELS,
+    RAPTOR,
+    CSA
+};
+
+// How buses become edges: an edge for every pair of stops a bus rides between, or
+// a chain of on-board vertices per bus that is boarded and left at the stops.
+enum class GraphModel {
+    STOP_PAIRS,
+    LINE
+};
+
+// Resolution of the fixed-point Floyd router: weights are kept in 1/1000 of a minute.
+constexpr double FIXED_POINT_SCALE = 1000;
+
+constexpr size_t DEFAULT_LANDMARK_COUNT = 8;
+
 struct RoutingSettings {
     int bus_wait_time;
     double bus_velocity;
+    RouterType router_type = RouterType::FLOYD;
+    size_t landmark_count = DEFAULT_LANDMARK_COUNT;
+    GraphModel graph_model = GraphModel::STOP_PAIRS;
+    // Megabytes the router may take, none when 0. make_base picks a router that fits.
+    size_t max_router_memory_mb = 0;
 };
 
 class TransportRoutes {
 public:
-    struct BusData {
-        size_t index;
-        size_t span_count;
+    // A BUS edge is a whole ride, wait included. The line graph splits a ride into
+    // boarding, one riding edge per span, and alighting.
+    enum class EdgeKind {
+        BUS,
+        BOARDING,
+        RIDING,
+        ALIGHTING
+    };
+
+    // The bus and span of an edge, stored as wide as the graph's ids.
+    template <typename Index>
+    struct BasicBusData {
+        BasicBusData() = default;
+        BasicBusData(size_t index, size_t span_count, EdgeKind kind = EdgeKind::BUS)
+            : index(static_cast<Index>(index))
+            , span_count(static_cast<Index>(span_count))
+            , kind(kind) {
+        }
+
+        Index index;
+        Index span_count;
+        EdgeKind kind = EdgeKind::BUS;
     };
+    using BusData = BasicBusData<graph::GraphIndex>;
 
     TransportRoutes() = default;
     
@@ -33,6 +92,10 @@ public:
     
     graph::VertexId GetVertexId(size_t stop_index) const;
 
+    // Appends the data of the edges and vertices the graph gained since, in their order.
+    // A new vertex of a stop that has none yet becomes the stop's vertex.
+    void Extend(std::vector<BusData> bus_data_by_edge_id, std::vector<size_t> stop_index_by_vertex_id);
+
     proto::TransportRoutes OutProto() const;
     void InProto(const proto::TransportRoutes& proto_transport_routes);
     
@@ -42,5 +105,191 @@ private:
     std::vector<size_t> stop_index_by_vertex_id_;
     std::unordered_map<size_t, graph::VertexId> vertex_id_by_stop_index_;
 };
+
+// One bus taken on a route: boarded at the stop, ridden for span_count stops.
+// The weight counts the wait for the bus too, which is wait_weight.
+struct Ride {
+    size_t bus_index;
+    size_t stop_index;
+    size_t span_count;
+    double weight;
+    double wait_weight;
+};
+
+struct Route {
+    double weight;
+    std::vector<Ride> rides;
+};
+
+struct StopArrival {
+    size_t stop_index;
+    double weight;
+};
+
+// Stops and buses that are out of service. Buses still pass closed stops, but nobody
+// gets on or off there.
+struct Closures {
+    std::vector<size_t> stop_indexs;
+    std::vector<size_t> bus_indexs;
+};
+
+// Queries are const, but builders and the searches they own may keep scratch buffers
+// between them, so a builder must not be shared between threads.
+class RouteBuilder {
+public:
+    virtual std::optional<Route> BuildRoute(size_t from_stop_index, size_t to_stop_index) const = 0;
+
+    // A route leaving at the time, in minutes from the start of the day. Builders without
+    // timetables wait the bus wait time at every stop whenever leaving, so by default it's BuildRoute.
+    virtual std::optional<Route> BuildRouteAt(size_t from_stop_index, size_t to_stop_index,
+                                              double departure_time) const;
+
+    // Routes from one stop to each of the given ones, by default one BuildRoute per stop.
+    virtual std::vector<std::optional<Route>> BuildRoutes(size_t from_stop_index,
+                                                          const std::vector<size_t>& to_stop_indexs) const;
+
+    // Stops reached from the stop within max_weight, the stop itself included.
+    virtual std::vector<StopArrival> FindReachableStops(size_t from_stop_index, double max_weight) const = 0;
+
+    // The fastest route for every number of rides that makes it faster, fewest rides first.
+    virtual std::vector<Route> BuildParetoRoutes(size_t from_stop_index, size_t to_stop_index) const = 0;
+
+    // Up to count routes in order of weight. By default only the best one.
+    virtual std::vector<Route> BuildAlternativeRoutes(size_t from_stop_index, size_t to_stop_index,
+                                                      size_t count) const;
+
+    // Closures every later query keeps out of, replacing the previous ones.
+    virtual void SetClosures(const Closures& closures) = 0;
+
+    // A route leaving at the time, as BuildRouteAt, that keeps out of the given stops and
+    // buses as well as the closures.
+    virtual std::optional<Route> BuildRouteAvoiding(size_t from_stop_index, size_t to_stop_index,
+                                                    double departure_time, const Closures& avoid) const = 0;
+
+    virtual ~RouteBuilder() = default;
+};
+
+// Closures as flags by stop and bus index, for the builders that route over the buses
+// rather than the graph.
+class ClosureFlags {
+public:
+    ClosureFlags(size_t stop_count, size_t bus_count);
+
+    bool IsStopClosed(size_t stop_index) const {
+        return stops_[stop_index];
+    }
+
+    bool IsBusClosed(size_t bus_index) const {
+        return buses_[bus_index];
+    }
+
+    // Replaces the closures.
+    void Set(const Closures& closures);
+
+    // Closes the stops and buses too and returns the ones that weren't closed yet,
+    // which Reopen takes back.
+    Closures Add(const Closures& closures);
+    void Reopen(const Closures& closures);
+
+private:
+    std::vector<bool> stops_;
+    std::vector<bool> buses_;
+};
+
+// Builds routes with a router over the graph of transport routes. Closures turn into a
+// mask over the graph that the searches keep out of, so the router's precomputed tables,
+// which don't know about them, give way to a plain Dijkstra's search while any are set.
+class GraphRouteBuilder final : public RouteBuilder {
+public:
+    GraphRouteBuilder(const graph::DirectedWeightedGraph<double>& transport_graph,
+                      const TransportRoutes& transport_routes,
+                      const graph::RouterBase<double>& router);
+
+    std::optional<Route> BuildRoute(size_t from_stop_index, size_t to_stop_index) const override;
+
+    std::vector<std::optional<Route>> BuildRoutes(size_t from_stop_index,
+                                                  const std::vector<size_t>& to_stop_indexs) const override;
+
+    // A bounded search over the graph, whatever the router.
+    std::vector<StopArrival> FindReachableStops(size_t from_stop_index, double max_weight) const override;
+
+    // A label-setting search over the graph, whatever the router.
+    std::vector<Route> BuildParetoRoutes(size_t from_stop_index, size_t to_stop_index) const override;
+
+    // Yen's loopless routes over the graph, whatever the router.
+    std::vector<Route> BuildAlternativeRoutes(size_t from_stop_index, size_t to_stop_index,
+                                              size_t count) const override;
+
+    void SetClosures(const Closures& closures) override;
+
+    std::optional<Route> BuildRouteAvoiding(size_t from_stop_index, size_t to_stop_index,
+                                            double departure_time, const Closures& avoid) const override;
+
+private:
+    Route MakeRoute(double weight, const std::vector<graph::EdgeId>& edges) const;
+
+    // Whether the two edges get off a bus and back on where staying on would do.
+    bool SplitsRide(graph::EdgeId first_edge_id, graph::EdgeId second_edge_id) const;
+
+    // Masks the vertices of the stops and the edges of the buses.
+    void AddToMask(const Closures& closures, graph::GraphMask& mask) const;
+
+    const graph::GraphMask* GetClosuresMask() const {
+        return has_closures_ ? &closures_mask_ : nullptr;
+    }
+
+    // The searches other than the router's are built on their first request, so a base
+    // that only asks for plain routes keeps nothing but the router per vertex.
+    const graph::IsochroneSearch<double>& GetIsochroneSearch() const;
+    const graph::ParetoRouter<double>& GetParetoRouter() const;
+    const graph::YenRouter<double>& GetYenRouter() const;
+    const graph::DijkstraRouter<double>& GetMaskedRouter() const;
+
+    const graph::DirectedWeightedGraph<double>& transport_graph_;
+    const TransportRoutes& transport_routes_;
+    const graph::RouterBase<double>& router_;
+    mutable std::optional<graph::IsochroneSearch<double>> isochrone_search_;
+    mutable std::optional<graph::ParetoRouter<double>> pareto_router_;
+    mutable std::optional<graph::YenRouter<double>> yen_router_;
+    mutable std::optional<graph::DijkstraRouter<double>> masked_router_;
+    // Edges of each bus, in compressed rows.
+    std::vector<size_t> bus_edge_offsets_;
+    std::vector<graph::EdgeId> bus_edges_;
+    graph::GraphMask closures_mask_;
+    bool has_closures_ = false;
+    // The edges of the last route built, kept so that routes don't allocate them anew.
+    mutable std::vector<graph::EdgeId> route_edges_;
+};
+
+// Returns nullptr for the router types that don't route over the graph.
+// vertex_coordinates are the coordinates of the stops by vertex id, which A* routes towards.
+std::unique_ptr<graph::RouterBase<double>> CreateRouter(
+    const graph::DirectedWeightedGraph<double>& transport_graph,
+    const RoutingSettings& routing_settings,
+    const std::vector<geo::Coordinates>& vertex_coordinates);
+
+std::unique_ptr<graph::RouterBase<double>> CreateRouter(
+    const graph::DirectedWeightedGraph<double>& transport_graph,
+    const RoutingSettings& routing_settings,
+    const std::vector<geo::Coordinates>& vertex_coordinates,
+    const proto::RouterData& proto_router_data);
+
+bool IsApproximateRouter(RouterType router_type);
+
+// Routers that run a search per route rather than look routes up in a table.
+bool IsSearchRouter(RouterType router_type);
+
+// Bytes the router takes at its peak over a graph of the size, the graph itself aside: its
+// precomputed data counts twice, for the copy in the base. Floyd's tables are close to it;
+// hub labels and contraction hierarchies depend on the graph's shape, and their estimates
+// err on the high side. Isochrones, Pareto and alternative routes add a search's buffers
+// each, on the first request for them.
+size_t EstimateRouterMemory(RouterType router_type, size_t vertex_count, size_t edge_count,
+                            const RoutingSettings& routing_settings);
+
+// The router type of the settings when it fits into max_router_memory_mb. Otherwise it is
+// the fastest slower graph router that fits, or Dijkstra's search if none does. Approximate
+// Floyd routers are taken only when asked for.
+RouterType SelectRouterType(const RoutingSettings& routing_settings, size_t vertex_count, size_t edge_count);
     
 } //namespace transport_router
\ No newline at end of file
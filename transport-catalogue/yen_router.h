@@ -0,0 +1,344 @@
+#pragma once
+
+#include "graph.h"
+#include "graph_mask.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// The k lightest loopless routes between two vertices by Yen's algorithm: every next route
+// leaves a previous one at some spur vertex, with the edges the earlier routes took there
+// and the vertices before the spur masked out.
+//
+// One shortest path tree into the target serves all the spur searches of a query: masking
+// only makes routes heavier, so its weights bound every spur search from below, and a spur
+// vertex whose tree path avoids the masks needs no search at all. Masks are bitsets over the
+// graph's edges and vertices, so the graph itself is never copied.
+template <typename Weight>
+class YenRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    // Whether taking the second edge right after the first splits what is one ride in two,
+    // such as getting off a bus only to get back on it.
+    using SplitsRide = std::function<bool(EdgeId, EdgeId)>;
+
+    explicit YenRouter(const Graph& graph);
+
+    // Up to count routes in order of weight, around the mask if there is one. With
+    // splits_ride, no route splits a ride, so the routes aren't the same ride cut up.
+    std::vector<RouteInfo> BuildRoutes(VertexId from, VertexId to, size_t count,
+                                       const GraphMask* mask = nullptr,
+                                       const SplitsRide& splits_ride = {}) const;
+
+private:
+    static constexpr Weight ZERO_WEIGHT{};
+
+    struct HeapItem {
+        Weight estimate;
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const HeapItem& other) const {
+            return estimate > other.estimate;
+        }
+    };
+
+    // The spur search labels edges, as whether an edge may follow depends on the one before.
+    struct SpurHeapItem {
+        Weight estimate;
+        Weight weight;
+        EdgeId edge_id;
+
+        bool operator>(const SpurHeapItem& other) const {
+            return estimate > other.estimate;
+        }
+    };
+
+    // Weights of the lightest routes from every vertex to the target, and the first edge of each.
+    void BuildTree(VertexId to, const GraphMask* mask) const;
+
+    void MaskEdge(EdgeId edge_id) const {
+        masked_edges_.Set(edge_id);
+        masked_edge_ids_.push_back(edge_id);
+    }
+
+    void MaskVertex(VertexId vertex) const {
+        masked_vertices_.Set(vertex);
+        masked_vertex_ids_.push_back(vertex);
+    }
+
+    void ClearMaskedEdges() const {
+        for (const EdgeId edge_id : masked_edge_ids_) {
+            masked_edges_.Reset(edge_id);
+        }
+        masked_edge_ids_.clear();
+    }
+
+    void ClearMaskedVertices() const {
+        for (const VertexId vertex : masked_vertex_ids_) {
+            masked_vertices_.Reset(vertex);
+        }
+        masked_vertex_ids_.clear();
+    }
+
+    bool IsInTree(VertexId vertex) const {
+        return tree_search_ids_[vertex] == search_id_;
+    }
+
+    // The lightest route from the spur vertex to the target around the masks that, after
+    // the root ending with root_edge, splits no ride.
+    std::optional<RouteInfo> BuildSpurRoute(VertexId spur, VertexId to, const GraphMask* mask,
+                                            std::optional<EdgeId> root_edge, const SplitsRide& splits_ride) const;
+
+    // Whether the edge may follow prev_edge, or start the route if there is none.
+    static bool MayFollow(const SplitsRide& splits_ride, std::optional<EdgeId> prev_edge, EdgeId edge_id) {
+        return !splits_ride || !prev_edge || !splits_ride(*prev_edge, edge_id);
+    }
+
+    const Graph& graph_;
+    // Edges into each vertex, in compressed rows.
+    std::vector<size_t> incoming_offsets_;
+    std::vector<EdgeId> incoming_edges_;
+
+    mutable uint32_t search_id_ = 0;
+    mutable std::vector<uint32_t> tree_search_ids_;
+    mutable std::vector<Weight> tree_weights_;
+    mutable std::vector<std::optional<EdgeId>> tree_edges_;
+
+    // Spur search labels, by the edge they end with.
+    mutable std::vector<uint32_t> spur_search_ids_;
+    mutable uint32_t spur_search_id_ = 0;
+    mutable std::vector<Weight> spur_weights_;
+    mutable std::vector<std::optional<EdgeId>> spur_prev_edges_;
+    mutable std::vector<SpurHeapItem> heap_;
+    mutable std::vector<VertexId> route_vertices_;
+
+    mutable Bitset masked_edges_;
+    mutable Bitset masked_vertices_;
+    mutable std::vector<EdgeId> masked_edge_ids_;
+    mutable std::vector<VertexId> masked_vertex_ids_;
+};
+
+template <typename Weight>
+YenRouter<Weight>::YenRouter(const Graph& graph)
+    : graph_(graph)
+    , incoming_offsets_(graph.GetVertexCount() + 1, 0)
+    , incoming_edges_(graph.GetEdgeCount())
+    , tree_search_ids_(graph.GetVertexCount())
+    , tree_weights_(graph.GetVertexCount())
+    , tree_edges_(graph.GetVertexCount())
+    , spur_search_ids_(graph.GetEdgeCount())
+    , spur_weights_(graph.GetEdgeCount())
+    , spur_prev_edges_(graph.GetEdgeCount())
+    , masked_edges_(graph.GetEdgeCount())
+    , masked_vertices_(graph.GetVertexCount())
+{
+    CheckEdgeWeightsNonNegative(graph);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        ++incoming_offsets_[graph.GetEdge(edge_id).to + 1];
+    }
+    for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+        incoming_offsets_[vertex + 1] += incoming_offsets_[vertex];
+    }
+    std::vector<size_t> positions(incoming_offsets_.begin(), incoming_offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        incoming_edges_[positions[graph.GetEdge(edge_id).to]++] = edge_id;
+    }
+}
+
+template <typename Weight>
+void YenRouter<Weight>::BuildTree(VertexId to, const GraphMask* mask) const {
+    NextSearchId(search_id_, tree_search_ids_);
+
+    std::vector<HeapItem> heap{{ZERO_WEIGHT, ZERO_WEIGHT, to}};
+    tree_search_ids_[to] = search_id_;
+    tree_weights_[to] = ZERO_WEIGHT;
+    tree_edges_[to] = std::nullopt;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+        const auto [_, weight, vertex] = heap.back();
+        heap.pop_back();
+        if (tree_weights_[vertex] < weight || (mask && mask->IsMasked(vertex))) {
+            continue;
+        }
+        for (size_t i = incoming_offsets_[vertex]; i < incoming_offsets_[vertex + 1]; ++i) {
+            const auto& edge = graph_.GetEdge(incoming_edges_[i]);
+            if (mask && (mask->edges.Test(incoming_edges_[i]) || mask->IsMasked(edge.from))) {
+                continue;
+            }
+            const Weight candidate_weight = weight + edge.weight;
+            if (!IsInTree(edge.from) || candidate_weight < tree_weights_[edge.from]) {
+                tree_search_ids_[edge.from] = search_id_;
+                tree_weights_[edge.from] = candidate_weight;
+                tree_edges_[edge.from] = incoming_edges_[i];
+                heap.push_back({candidate_weight, candidate_weight, edge.from});
+                std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>{});
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename YenRouter<Weight>::RouteInfo> YenRouter<Weight>::BuildSpurRoute(
+    VertexId spur, VertexId to, const GraphMask* mask, std::optional<EdgeId> root_edge,
+    const SplitsRide& splits_ride) const
+{
+    // Vertices the tree doesn't reach can't reach the target at all, and the tree
+    // keeps out of the mask.
+    if (!IsInTree(spur)) {
+        return std::nullopt;
+    }
+
+    RouteInfo route{tree_weights_[spur], {}};
+    bool tree_route_is_free = true;
+    std::optional<EdgeId> prev_edge = root_edge;
+    for (VertexId vertex = spur; vertex != to;) {
+        const EdgeId edge_id = *tree_edges_[vertex];
+        vertex = graph_.GetEdge(edge_id).to;
+        if (masked_edges_.Test(edge_id) || masked_vertices_.Test(vertex)
+            || !MayFollow(splits_ride, prev_edge, edge_id)) {
+            tree_route_is_free = false;
+            break;
+        }
+        route.edges.push_back(edge_id);
+        prev_edge = edge_id;
+    }
+    if (tree_route_is_free) {
+        return route;
+    }
+
+    // A* towards the target with the tree weights as the bound. A label that can't go on
+    // from a vertex after its last edge mustn't keep a heavier one over another edge from
+    // going on, so labels are kept by the edge they end with.
+    NextSearchId(spur_search_id_, spur_search_ids_);
+    heap_.clear();
+    const auto relax = [&](VertexId vertex, Weight weight, std::optional<EdgeId> last_edge) {
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (!IsInTree(edge.to) || masked_edges_.Test(edge_id) || masked_vertices_.Test(edge.to)
+                || (mask && mask->edges.Test(edge_id))
+                || !MayFollow(splits_ride, last_edge ? last_edge : root_edge, edge_id)) {
+                continue;
+            }
+            const Weight candidate_weight = weight + edge.weight;
+            if (spur_search_ids_[edge_id] != spur_search_id_ || candidate_weight < spur_weights_[edge_id]) {
+                spur_search_ids_[edge_id] = spur_search_id_;
+                spur_weights_[edge_id] = candidate_weight;
+                spur_prev_edges_[edge_id] = last_edge;
+                heap_.push_back({candidate_weight + tree_weights_[edge.to], candidate_weight, edge_id});
+                std::push_heap(heap_.begin(), heap_.end(), std::greater<SpurHeapItem>{});
+            }
+        }
+    };
+    relax(spur, ZERO_WEIGHT, std::nullopt);
+    while (!heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<SpurHeapItem>{});
+        const auto [_, weight, edge_id] = heap_.back();
+        heap_.pop_back();
+        if (spur_weights_[edge_id] < weight) {
+            continue;
+        }
+        const VertexId vertex = graph_.GetEdge(edge_id).to;
+        if (vertex != to) {
+            relax(vertex, weight, edge_id);
+            continue;
+        }
+        route = {weight, {}};
+        route_vertices_ = {spur};
+        for (std::optional<EdgeId> route_edge_id = edge_id; route_edge_id; route_edge_id = spur_prev_edges_[*route_edge_id]) {
+            route.edges.push_back(*route_edge_id);
+            route_vertices_.push_back(graph_.GetEdge(*route_edge_id).to);
+        }
+        std::reverse(route.edges.begin(), route.edges.end());
+        // Such labels may come back to a vertex to go on from it by another edge, which a
+        // loopless route can't, so the search goes on to a heavier one.
+        std::sort(route_vertices_.begin(), route_vertices_.end());
+        if (std::adjacent_find(route_vertices_.begin(), route_vertices_.end()) == route_vertices_.end()) {
+            return route;
+        }
+    }
+    return std::nullopt;
+}
+
+template <typename Weight>
+std::vector<typename YenRouter<Weight>::RouteInfo> YenRouter<Weight>::BuildRoutes(
+    VertexId from, VertexId to, size_t count, const GraphMask* mask, const SplitsRide& splits_ride) const
+{
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+
+    std::vector<RouteInfo> routes;
+    if (count == 0) {
+        return routes;
+    }
+    BuildTree(to, mask);
+    if (const auto route = BuildSpurRoute(from, to, mask, std::nullopt, splits_ride)) {
+        routes.push_back(*route);
+    } else {
+        return routes;
+    }
+
+    const auto is_heavier = [](const RouteInfo& lhs, const RouteInfo& rhs) { return lhs.weight > rhs.weight; };
+    std::vector<RouteInfo> candidates;
+    std::set<std::vector<EdgeId>> known_routes{routes.front().edges};
+    while (routes.size() < count) {
+        const std::vector<EdgeId> last_edges = routes.back().edges;
+        VertexId spur = from;
+        Weight root_weight = ZERO_WEIGHT;
+        for (size_t i = 0; i < last_edges.size(); ++i) {
+            // Routes sharing the root leave the spur by different edges than the ones taken.
+            for (const RouteInfo& route : routes) {
+                if (route.edges.size() > i && std::equal(last_edges.begin(), last_edges.begin() + i, route.edges.begin())) {
+                    MaskEdge(route.edges[i]);
+                }
+            }
+            std::optional<EdgeId> root_edge;
+            if (i > 0) {
+                root_edge = last_edges[i - 1];
+            }
+            if (const auto spur_route = BuildSpurRoute(spur, to, mask, root_edge, splits_ride)) {
+                std::vector<EdgeId> edges(last_edges.begin(), last_edges.begin() + i);
+                edges.insert(edges.end(), spur_route->edges.begin(), spur_route->edges.end());
+                if (known_routes.insert(edges).second) {
+                    candidates.push_back({root_weight + spur_route->weight, std::move(edges)});
+                    std::push_heap(candidates.begin(), candidates.end(), is_heavier);
+                }
+            }
+            ClearMaskedEdges();
+
+            // The root can't be visited again.
+            MaskVertex(spur);
+            const auto& edge = graph_.GetEdge(last_edges[i]);
+            root_weight += edge.weight;
+            spur = edge.to;
+        }
+        ClearMaskedVertices();
+
+        if (candidates.empty()) {
+            break;
+        }
+        std::pop_heap(candidates.begin(), candidates.end(), is_heavier);
+        routes.push_back(std::move(candidates.back()));
+        candidates.pop_back();
+    }
+    return routes;
+}
+
+}  // namespace graph